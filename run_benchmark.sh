@@ -1,5 +1,7 @@
 
-# First collect memory usage
+# First collect memory usage of whole runs, the executables also write the
+# memory of each phase (loading, building, searching, output) to
+# cpp_benchmark_phases.csv
 
 READS_FILE=./data/illumina_reads_100.fasta.gz
 REFERENCE_FILE=./data/hg38_partial.fasta.gz
@@ -7,11 +9,16 @@ FMINDEX_FILE=test.index
 
 MEM_OUTPUT_FILE=cpp_memory_benchmark.csv
 echo "method,reference_file,reads_file,read_num,mem_usage" > $MEM_OUTPUT_FILE
+
+# the hits go to /dev/null, \time writes the peak RSS in KB to its own file
+MEM_USAGE_FILE=mem_usage.txt
+
 ## Naive search
 read_nums=(1000)
 for read_num in "${read_nums[@]}"
 do
-	mem_usage=`\time -f "%M"  ./build/bin/naive_search --query $READS_FILE --reference $REFERENCE_FILE --query_ct $read_num 2>&1 | tail -n 1`
+	\time -f "%M" -o $MEM_USAGE_FILE ./build/bin/naive_search --query $READS_FILE --reference $REFERENCE_FILE --query_ct $read_num --output /dev/null
+	mem_usage=`cat $MEM_USAGE_FILE`
 	echo "naive,${REFERENCE_FILE},${READS_FILE},${read_num},${mem_usage}" >> $MEM_OUTPUT_FILE
 done
 
@@ -21,7 +28,8 @@ done
 read_nums=(1000 10000 100000 1000000)
 for read_num in "${read_nums[@]}"
 do
-	mem_usage=`\time -f "%M" ./build/bin/suffixarray_search --query $READS_FILE --reference $REFERENCE_FILE --query_ct $read_num  2>&1 | tail -n 1`
+	\time -f "%M" -o $MEM_USAGE_FILE ./build/bin/suffixarray_search --query $READS_FILE --reference $REFERENCE_FILE --query_ct $read_num --output /dev/null
+	mem_usage=`cat $MEM_USAGE_FILE`
 	echo "sa,${REFERENCE_FILE},${READS_FILE},${read_num},${mem_usage}" >> $MEM_OUTPUT_FILE
 done
 
@@ -29,22 +37,24 @@ done
 read_nums=(1000 10000 100000 1000000)
 for read_num in "${read_nums[@]}"
 do
-	mem_usage=`\time -f "%M" ./build/bin/fmindex_search --query $READS_FILE --index $FMINDEX_FILE --query_ct $read_num 2>&1 | tail -n 1`
+	\time -f "%M" -o $MEM_USAGE_FILE ./build/bin/fmindex_search --query $READS_FILE --index $FMINDEX_FILE --query_ct $read_num --output /dev/null
+	mem_usage=`cat $MEM_USAGE_FILE`
 	echo "fm,${FMINDEX_FILE},${READS_FILE},${read_num},${mem_usage}" >> $MEM_OUTPUT_FILE
 done
 
+rm -f $MEM_USAGE_FILE
+
 # remove any existing benchmark file
 rm cpp_benchmark.csv
 
 # Now collect processing per read num
-./build/bin/naive_search --query $READS_FILE --reference $REFERENCE_FILE --query_ct 1011 
-./build/bin/suffixarray_search --query $READS_FILE --reference $REFERENCE_FILE --query_ct 1000011
+./build/bin/naive_search --query $READS_FILE --reference $REFERENCE_FILE --query_ct 1011 --output /dev/null
+./build/bin/suffixarray_search --query $READS_FILE --reference $REFERENCE_FILE --query_ct 1000011 --output /dev/null
 
 # benchmark does not work well per read with seqan3 api used in fmindex_search
-# so manually loop over a bunch of read_num so we can still get something we can
-# plot later
+# so the read sweep runs in search_bench, which loads the index and the reads
+# once and writes the median and its confidence interval per read_num to
+# search_bench.csv and search_bench.json
 
-for i in {100..1000100..100}
-do
-	./build/bin/fmindex_search --query $READS_FILE --index $FMINDEX_FILE --query_ct $i
-done
+rm -f search_bench.csv
+./build/bin/search_bench --query $READS_FILE --index $FMINDEX_FILE $(printf -- '--query_ct %d ' {100..1000100..10000})
@@ -0,0 +1,39 @@
+# Sweeps the suffix array sampling rate of a native index and records index
+# size, load time and locate throughput, use it to pick --sa-sampling for
+# the memory of a machine
+
+READS_FILE=./data/illumina_reads_100.fasta.gz
+REFERENCE_FILE=./data/hg38_partial.fasta.gz
+READ_NUM=100000
+
+OUTPUT_FILE=cpp_locate_benchmark.csv
+echo "sa_sampling,index_size,load_ms,search_ms,count_ms,hits,locates_per_s" > $OUTPUT_FILE
+
+# time column of the last cpp_benchmark.csv line of a method
+last_time() {
+	grep "^$1," cpp_benchmark.csv | tail -n 1 | cut -d, -f5
+}
+
+sampling_rates=(1 2 4 8 16 32 64 128)
+for rate in "${sampling_rates[@]}"
+do
+	index=locate_sa${rate}.index
+	./build/bin/fmindex_construct --reference $REFERENCE_FILE --index $index --backend native --sa-sampling $rate
+	index_size=`stat -c "%s" $index`
+
+	# full locate, the hits are written in the binary format to /dev/null so
+	# that formatting them costs as little as possible
+	./build/bin/fmindex_search --index $index --query $READS_FILE --query_ct $READ_NUM --format binary --output /dev/null
+	load_ms=`last_time fmindex_load`
+	search_ms=`last_time native_fm_index`
+
+	# same search without locating, the difference is the locate cost; the
+	# counts per read (X0:i:) add up to the number of hits
+	./build/bin/fmindex_search --index $index --query $READS_FILE --query_ct $READ_NUM --count-only --output locate_counts.sam
+	count_ms=`last_time native_fm_index_count`
+	hits=`awk -F 'X0:i:' '{ hits += $2 } END { print hits + 0 }' locate_counts.sam`
+
+	locates_per_s=`awk -v hits=$hits -v search=$search_ms -v count=$count_ms 'BEGIN { ms = search - count; print (ms > 0 ? int(hits * 1000 / ms) : "inf") }'`
+	echo "${rate},${index_size},${load_ms},${search_ms},${count_ms},${hits},${locates_per_s}" >> $OUTPUT_FILE
+	rm $index locate_counts.sam
+done
@@ -0,0 +1,123 @@
+#ifndef BANDED_ALIGNMENT_HPP
+#define BANDED_ALIGNMENT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+#include "packed_sequence.hpp"
+
+// the best alignment found by banded_edit_distance
+struct BandedAlignment {
+    size_t begin  = 0; // first aligned position of the reference
+    int    errors = 0; // larger than the allowed errors if there is none
+};
+
+// Edit distance of the whole `read` against the reference, the alignment has
+// to start within `max_errors` positions of `diagonal` and may end anywhere.
+// With at most max_errors edits the alignment never leaves the band of
+// diagonals [diagonal - max_errors, diagonal + max_errors], so only 2k + 1
+// cells per read position are computed. The band is a fixed size array for
+// the common error counts, so the row update is a short loop the compiler
+// can unroll and vectorize. Ties are broken by the smaller begin.
+template <typename limit_t>
+BandedAlignment banded_edit_distance_impl(PackedView const& reference, std::span<seqan3::dna5 const> read, size_t diagonal, limit_t limit) {
+    constexpr bool fixed = !std::is_same_v<limit_t, int>;
+    constexpr int  infinity = 1 << 24;
+    int const k     = limit;
+    int const width = 2 * k + 1;
+
+    // cell b of a row of read position i ends before reference position
+    // diagonal + i + b - k, the cost and begin of its best alignment
+    using row_t = std::conditional_t<fixed, std::array<int, 2 * limit_t{} + 1>, std::vector<int>>;
+    auto cost  = row_t{};
+    auto begin = row_t{};
+    if constexpr (!fixed) {
+        cost.resize(width);
+        begin.resize(width);
+    }
+
+    auto const length = static_cast<int64_t>(reference.length);
+    auto const first  = static_cast<int64_t>(diagonal) - k;
+
+    // N runs are rare, the bases of a window that has none are compared without looking them up
+    auto const window_end = first + static_cast<int64_t>(read.size()) + 2 * k;
+    auto run = std::ranges::upper_bound(reference.n_runs, static_cast<uint64_t>(std::max<int64_t>(first, 0)), {}, &NRun::end);
+    bool const has_n = run != reference.n_runs.end() && static_cast<int64_t>(run->begin) < window_end;
+    auto reference_rank = [&](int64_t position) -> int {
+        constexpr int ranks[] = {0, 1, 2, 4}; // dna5 rank of a 2-bit code
+        if (has_n && reference.is_n(position)) return 3;
+        return ranks[reference.code(position)];
+    };
+
+    for (int b = 0; b < width; ++b) {
+        auto const end = first + b;
+        cost[b]  = end >= 0 && end <= length ? 0 : infinity;
+        begin[b] = static_cast<int>(b);
+    }
+
+    for (size_t i = 0; i < read.size(); ++i) {
+        int const rank = read[i].to_rank();
+        int best = infinity;
+        for (int b = 0; b < width; ++b) {
+            // the new cell b consumes the reference base before its end
+            auto const position = first + static_cast<int64_t>(i) + b;
+            auto value = infinity;
+            auto from  = begin[b];
+            if (position >= 0 && position < length) {
+                value = cost[b] + int{reference_rank(position) != rank};
+            }
+            if (b + 1 < width && cost[b + 1] + 1 < value) { // base of the read against a gap
+                value = cost[b + 1] + 1;
+                from  = begin[b + 1];
+            }
+            cost[b]  = value;
+            begin[b] = from;
+        }
+        for (int b = 1; b < width; ++b) { // base of the reference against a gap
+            auto const end = first + static_cast<int64_t>(i) + 1 + b;
+            if (end <= length && cost[b - 1] + 1 < cost[b]) {
+                cost[b]  = cost[b - 1] + 1;
+                begin[b] = begin[b - 1];
+            }
+            best = std::min(best, cost[b]);
+        }
+        best = std::min(best, cost[0]);
+        if (best > k) return {0, best};
+    }
+
+    auto result = BandedAlignment{0, infinity};
+    int result_begin = 0;
+    for (int b = 0; b < width; ++b) {
+        if (cost[b] < result.errors || (cost[b] == result.errors && begin[b] < result_begin)) {
+            result.errors = cost[b];
+            result_begin  = begin[b];
+        }
+    }
+    result.begin = static_cast<size_t>(first + result_begin);
+    return result;
+}
+
+template <int max_errors>
+BandedAlignment banded_edit_distance(PackedView const& reference, std::span<seqan3::dna5 const> read, size_t diagonal) {
+    return banded_edit_distance_impl(reference, read, diagonal, std::integral_constant<int, max_errors>{});
+}
+
+inline BandedAlignment banded_edit_distance(PackedView const& reference, std::span<seqan3::dna5 const> read, size_t diagonal, int max_errors) {
+    switch (max_errors) {
+        case 0: return banded_edit_distance<0>(reference, read, diagonal);
+        case 1: return banded_edit_distance<1>(reference, read, diagonal);
+        case 2: return banded_edit_distance<2>(reference, read, diagonal);
+        case 3: return banded_edit_distance<3>(reference, read, diagonal);
+        case 4: return banded_edit_distance<4>(reference, read, diagonal);
+        default: return banded_edit_distance_impl(reference, read, diagonal, max_errors);
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef BATCHED_SEARCH_HPP
+#define BATCHED_SEARCH_HPP
+
+#include "fm_native.hpp"
+#include "kmer_table.hpp"
+
+#include <cstddef>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// whether the occurrence table can prefetch the block holding a position;
+// searches are only interleaved on indices with such a table, otherwise
+// round robin would just reorder the occ lookups
+template <typename occ_t>
+constexpr bool occ_can_prefetch = requires (occ_t const& occ, size_t idx) { occ.prefetch(idx); };
+template <typename index_t>
+constexpr bool index_can_prefetch = requires (index_t const& index, size_t idx) { index.occ.prefetch(idx); };
+
+// the same for the occurrence table named `name`, see visit_occ_table
+inline bool occ_table_can_prefetch(std::string_view name) {
+    bool can_prefetch = false;
+    visit_occ_table(name, [&]<typename occ_t>(std::type_identity<occ_t>) {
+        can_prefetch = occ_can_prefetch<occ_t>;
+    });
+    return can_prefetch;
+}
+
+// asks the occurrence table to prefetch the block holding `idx`
+template <typename index_t>
+void prefetch_occ(index_t const& index, size_t idx) {
+    index.occ.prefetch(idx);
+}
+
+// Exact backward search of many queries at once. Up to `width` searches are in
+// flight and advanced by one LF step each in round robin; after a step the occ
+// blocks needed by the next step of that search are prefetched, so the memory
+// latency of one search overlaps with the steps of the others.
+// `report(query_id, interval)` is called once per query, in no particular order.
+template <typename index_t, typename queries_t, typename report_t>
+void batched_backward_search(index_t const& index, queries_t const& queries, size_t width, report_t&& report, KmerTable const* kmer_table = nullptr) {
+    static_assert(index_can_prefetch<index_t>, "interleaving needs an occurrence table that can prefetch");
+    struct Slot {
+        size_t         query_id;
+        size_t         remaining; // number of query positions not yet searched
+        NativeInterval iv;
+    };
+
+    auto const query_count = std::ranges::size(queries);
+    auto slots = std::vector<Slot>{};
+    slots.reserve(width);
+    size_t next_query = 0;
+
+    // starts the next query in `slot`, queries that are already done (empty or
+    // fully answered by the k-mer table) are reported right away
+    auto start = [&](Slot& slot) {
+        while (next_query < query_count) {
+            auto const& query = queries[next_query];
+            slot = {next_query++, std::ranges::size(query), full_interval(index)};
+            if (kmer_table && !kmer_table->empty()) {
+                if (auto iv = kmer_table->lookup(query)) {
+                    slot.iv = *iv;
+                    slot.remaining -= kmer_table->k;
+                }
+            }
+            if (slot.remaining > 0 && !slot.iv.empty()) {
+                prefetch_occ(index, slot.iv.lb);
+                prefetch_occ(index, slot.iv.lb + slot.iv.len);
+                return true;
+            }
+            report(slot.query_id, slot.iv);
+        }
+        return false;
+    };
+
+    for (size_t i = 0; i < width; ++i) {
+        auto slot = Slot{};
+        if (!start(slot)) break;
+        slots.push_back(slot);
+    }
+
+    while (!slots.empty()) {
+        for (size_t i = 0; i < slots.size();) {
+            auto& slot = slots[i];
+            auto symb  = native_symbol(queries[slot.query_id][slot.remaining - 1]);
+            slot.iv = extend_left(index, slot.iv, symb);
+            --slot.remaining;
+
+            if (slot.remaining > 0 && !slot.iv.empty()) {
+                prefetch_occ(index, slot.iv.lb);
+                prefetch_occ(index, slot.iv.lb + slot.iv.len);
+                ++i;
+                continue;
+            }
+
+            report(slot.query_id, slot.iv);
+            if (!start(slot)) {
+                // no queries left, close the gap by moving the last slot here
+                slot = slots.back();
+                slots.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+}
+
+#endif
@@ -1,22 +1,148 @@
 #include "benchmark.hpp"
+#include "perf_counters.hpp"
 
-#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include <sys/resource.h>
+
+namespace {
+
+// end of the last phase of the process and the rows of all phases so far,
+// see Benchmark::phase
+auto last_phase_end = std::chrono::high_resolution_clock::now();
+PerfCounters counters;
+auto last_phase_counters = counters.read();
+std::vector<std::string> phase_rows;
+int live_benchmarks = 0;
+
+struct MemoryUsage {
+	long rss_kb      = 0;
+	long peak_rss_kb = 0;
+};
+
+// resident set size and its peak from /proc/self/status, getrusage for the
+// peak where there is no /proc
+MemoryUsage memory_usage() {
+	auto usage = MemoryUsage{};
+	std::ifstream status{"/proc/self/status"};
+	for (std::string line; std::getline(status, line);) {
+		auto const colon = line.find(':');
+		if (colon == std::string::npos) continue;
+		auto key = line.substr(0, colon);
+		if (key != "VmRSS" && key != "VmHWM") continue;
+		long value = 0;
+		std::istringstream{line.substr(colon + 1)} >> value;
+		(key == "VmRSS" ? usage.rss_kb : usage.peak_rss_kb) = value;
+	}
+	if (usage.peak_rss_kb == 0) {
+		rusage self{};
+		if (getrusage(RUSAGE_SELF, &self) == 0) {
+			usage.peak_rss_kb = self.ru_maxrss;
+		}
+	}
+	return usage;
+}
+
+// lets VmHWM start over at the current RSS, a no-op where the kernel does not support it
+void reset_peak_rss() {
+	std::ofstream{"/proc/self/clear_refs"} << "5";
+}
+
+}
 
 Benchmark::Benchmark(std::string method, std::filesystem::path reference_path, std::filesystem::path query_path, int number_of_errors) {
    this->method = method;
    this->reference_path = reference_path;
    this->query_path = query_path;
    this->number_of_errors = number_of_errors;
-   // setup benchmarking output file
-    std::ifstream benchmark_in;
-    benchmark_out.open("cpp_benchmark.csv", std::ios_base::app);
+   ++live_benchmarks;
+   // the searches write a row every 10 reads, the buffer only grows for very long runs
+   progress.reserve(1 << 16);
+}
 
-    benchmark_in.open("cpp_benchmark.csv");
-    if (benchmark_in.peek() == std::ifstream::traits_type::eof()) {
-	benchmark_out << "method,number_of_errors,reference_file,reads_file,time,read_n\n";
-    }
+// the files are only opened here, after the measured work is done
+Benchmark::~Benchmark() {
+	auto append = [](char const* path, char const* header) {
+		std::ifstream in{path};
+		bool const empty = in.peek() == std::ifstream::traits_type::eof();
+		std::ofstream out{path, std::ios_base::app};
+		if (empty) {
+			out << header;
+		}
+		return out;
+	};
+
+	auto benchmark_out = append("cpp_benchmark.csv", "method,number_of_errors,reference_file,reads_file,time,read_n\n");
+	for (auto const& [time, read_num] : progress) {
+		benchmark_out << method << "," << number_of_errors << "," << reference_path << "," << query_path << "," << std::chrono::duration_cast<std::chrono::milliseconds>(time - start_time).count() << "," << read_num << "\n";
+	}
+
+	if (--live_benchmarks == 0 && !phase_rows.empty()) {
+		auto phases_out = append("cpp_benchmark_phases.csv", "method,number_of_errors,reference_file,reads_file,phase,time,rss_kb,peak_rss_kb,"
+		                                                     "cycles,instructions,llc_misses,dtlb_misses,branch_misses\n");
+		for (auto const& row : phase_rows) {
+			phases_out << row;
+		}
+		phase_rows.clear();
+	}
+
+	if (latencies.count() > 0) {
+		stats.emplace_back("latency_p50_ns", latencies.percentile(0.5));
+		stats.emplace_back("latency_p99_ns", latencies.percentile(0.99));
+		stats.emplace_back("latency_p999_ns", latencies.percentile(0.999));
+	}
+	if (chunk_latencies.count() > 0) {
+		stats.emplace_back("chunk_latency_p50_ns", chunk_latencies.percentile(0.5));
+		stats.emplace_back("chunk_latency_p99_ns", chunk_latencies.percentile(0.99));
+		stats.emplace_back("chunk_latency_p999_ns", chunk_latencies.percentile(0.999));
+		stats.emplace_back("queries_per_chunk", static_cast<double>(chunked_queries) / chunk_latencies.count());
+	}
+	if (stats.empty()) return;
+	auto stats_out = append("cpp_benchmark_stats.csv", "method,number_of_errors,reference_file,reads_file,stat,value\n");
+	stats_out.precision(15); // latencies in ns without an exponent
+	for (auto const& [name, value] : stats) {
+		stats_out << method << "," << number_of_errors << "," << reference_path << "," << query_path << "," << name << "," << value << "\n";
+	}
 }
 
 void Benchmark::write(int read_num) {
-	benchmark_out << method << "," << number_of_errors << "," << reference_path << "," << query_path << "," << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - this->start_time).count() << "," << read_num << std::endl;
+	progress.push_back({clock::now(), read_num});
+}
+
+void Benchmark::record_query(std::chrono::nanoseconds duration) {
+	std::lock_guard lock{latency_mutex};
+	latencies.record(static_cast<uint64_t>(duration.count()));
+}
+
+void Benchmark::record_chunk(std::chrono::nanoseconds duration, size_t count) {
+	std::lock_guard lock{latency_mutex};
+	chunk_latencies.record(static_cast<uint64_t>(duration.count()));
+	chunked_queries += count;
+}
+
+void Benchmark::phase(std::string const& name) {
+	auto const now   = clock::now();
+	auto const phase_counters = counters.read();
+	auto const usage = memory_usage();
+	auto row = std::ostringstream{};
+	row << method << "," << number_of_errors << "," << reference_path << "," << query_path << "," << name << ","
+	    << std::chrono::duration_cast<std::chrono::milliseconds>(now - last_phase_end).count() << "," << usage.rss_kb << "," << usage.peak_rss_kb;
+	// counters that could not be opened are left empty
+	for (size_t i = 0; i < PerfCounters::count; ++i) {
+		row << ",";
+		if (phase_counters[i] && last_phase_counters[i]) {
+			row << *phase_counters[i] - *last_phase_counters[i];
+		}
+	}
+	row << "\n";
+	phase_rows.push_back(row.str());
+	reset_peak_rss();
+	// the /proc accesses belong to no phase
+	last_phase_counters = counters.read();
+	last_phase_end = clock::now();
+}
+
+void Benchmark::write_stat(std::string const& name, double value) {
+	stats.emplace_back(name, value);
 }
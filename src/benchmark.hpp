@@ -1,22 +1,68 @@
 #ifndef BENCHMARK_HPP
 #define BENCHMARK_HPP
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <fstream>
 #include <filesystem>
+#include <mutex>
+#include <utility>
+#include <vector>
 
+#include "latency_histogram.hpp"
+
+// Records the progress of a run in memory; nothing is written until the
+// Benchmark is destroyed, so the timed loops never format or flush. Rows of
+// write() go to cpp_benchmark.csv, statistics and the latency percentiles
+// of record_query() and record_chunk() to cpp_benchmark_stats.csv and the
+// phases of phase() to cpp_benchmark_phases.csv.
 class Benchmark {
 	private:
+		using clock = std::chrono::high_resolution_clock;
+
+		struct Progress {
+			clock::time_point time;
+			int read_num;
+		};
+
 		std::string method;
 		std::filesystem::path reference_path;
 		std::filesystem::path query_path;
-		std::ofstream benchmark_out;
-		const std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+		const clock::time_point start_time = clock::now();
 		int number_of_errors;
-	
+
+		std::vector<Progress> progress;                     // preallocated, see the constructor
+		std::vector<std::pair<std::string, double>> stats;
+		std::mutex latency_mutex;
+		LatencyHistogram latencies;       // of single queries
+		LatencyHistogram chunk_latencies; // of chunks of queries
+		size_t chunked_queries = 0;
+
 	public:
 		Benchmark(std::string method, std::filesystem::path reference_path, std::filesystem::path query_path, int number_of_errors);
+		~Benchmark();
+		Benchmark(Benchmark const&) = delete;
+		Benchmark& operator=(Benchmark const&) = delete;
+
+		// notes that read_num reads are done, one row of cpp_benchmark.csv
 		void write(int read_num);
+		// notes the time the search of a single query took, measured by the
+		// thread that searched it (latency_p50_ns, ...)
+		void record_query(std::chrono::nanoseconds duration);
+		// notes the time a chunk of `count` queries took on the thread that
+		// searched it, for engines that search chunks rather than single
+		// queries (chunk_latency_p50_ns, ...); both may be called concurrently
+		void record_chunk(std::chrono::nanoseconds duration, size_t count);
+		// Ends the phase `name` (load_reference, build_index, search, ...) of the
+		// process. Phases follow each other across all Benchmarks: a phase
+		// lasts from the end of the previous one, or from the start of the
+		// process, and its peak RSS is the peak since then (Linux 4.0 or later,
+		// elsewhere the peak of the whole process so far). The phases are
+		// written in order once no Benchmark is left.
+		void phase(std::string const& name);
+		// appends a statistic of the run, e.g. candidates per read, to cpp_benchmark_stats.csv
+		void write_stat(std::string const& name, double value);
 };
 
 #endif
@@ -0,0 +1,103 @@
+#ifndef CHUNK_SCHEDULER_HPP
+#define CHUNK_SCHEDULER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Processes the items [0, item_count) in chunks of `chunk_size` items on
+// `thread_count` threads by calling `f(thread_id, begin, end)` per chunk.
+//
+// Every thread starts with an equal, contiguous share of the chunks and takes
+// them from the front. A thread that runs out steals the back half of the
+// chunks left to the thread with the most remaining work, so a few expensive
+// chunks (e.g. repetitive reads) do not leave the other threads idle.
+// With a single thread all chunks are processed in order by the caller.
+template <typename F>
+void parallel_chunks(size_t item_count, size_t chunk_size, size_t thread_count, F&& f) {
+    chunk_size   = std::max<size_t>(chunk_size, 1);
+    thread_count = std::max<size_t>(thread_count, 1);
+    auto const chunk_count = (item_count + chunk_size - 1) / chunk_size;
+
+    auto run_chunk = [&](size_t thread_id, size_t chunk) {
+        f(thread_id, chunk * chunk_size, std::min(item_count, (chunk + 1) * chunk_size));
+    };
+
+    if (thread_count == 1) {
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            run_chunk(0, chunk);
+        }
+        return;
+    }
+
+    // chunks [next, end) still belong to a thread
+    struct Queue {
+        std::mutex mutex;
+        size_t     next;
+        size_t     end;
+    };
+    auto queues = std::vector<Queue>(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues[i].next = chunk_count * i / thread_count;
+        queues[i].end  = chunk_count * (i + 1) / thread_count;
+    }
+
+    auto take = [&](size_t thread_id, size_t& chunk) {
+        auto& own = queues[thread_id];
+        std::lock_guard lock{own.mutex};
+        if (own.next == own.end) return false;
+        chunk = own.next++;
+        return true;
+    };
+
+    // moves the back half of the fullest queue to the own (empty) queue
+    auto steal = [&](size_t thread_id) {
+        while (true) {
+            size_t victim  = thread_id;
+            size_t largest = 0;
+            for (size_t i = 0; i < thread_count; ++i) {
+                std::lock_guard lock{queues[i].mutex};
+                if (queues[i].end - queues[i].next > largest) {
+                    largest = queues[i].end - queues[i].next;
+                    victim  = i;
+                }
+            }
+            if (largest == 0) return false;
+
+            size_t begin, end;
+            {
+                std::lock_guard lock{queues[victim].mutex};
+                auto& v = queues[victim];
+                if (v.next == v.end) continue; // emptied in the meantime, look again
+                end    = v.end;
+                begin  = v.next + (v.end - v.next) / 2;
+                v.end  = begin;
+            }
+            std::lock_guard lock{queues[thread_id].mutex};
+            queues[thread_id].next = begin;
+            queues[thread_id].end  = end;
+            return true;
+        }
+    };
+
+    auto worker = [&](size_t thread_id) {
+        size_t chunk;
+        while (true) {
+            if (take(thread_id, chunk)) {
+                run_chunk(thread_id, chunk);
+            } else if (!steal(thread_id)) {
+                break;
+            }
+        }
+    };
+
+    auto threads = std::vector<std::jthread>{};
+    for (size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+}
+
+#endif
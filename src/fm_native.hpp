@@ -0,0 +1,186 @@
+#ifndef FM_NATIVE_HPP
+#define FM_NATIVE_HPP
+
+#include "search_schemes.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <fmindex-collection/fmindex-collection.h>
+#include <fmindex-collection/occtable/all.h>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+// fmindex-collection reserves symbol 0 as delimiter between the references,
+// dna5 ranks are therefore shifted by one
+constexpr size_t native_sigma = seqan3::alphabet_size<seqan3::dna5> + 1;
+
+template <typename OccTable> using NativeIndex   = fmindex_collection::FMIndex<OccTable>;
+template <typename OccTable> using NativeBiIndex = fmindex_collection::BiFMIndex<OccTable>;
+
+template <typename T> constexpr bool is_native_index = false;
+template <typename OccTable> constexpr bool is_native_index<NativeIndex<OccTable>>   = true;
+template <typename OccTable> constexpr bool is_native_index<NativeBiIndex<OccTable>> = true;
+
+template <typename T> constexpr bool is_native_bi_index = false;
+template <typename OccTable> constexpr bool is_native_bi_index<NativeBiIndex<OccTable>> = true;
+
+// names of the selectable occurrence tables, see visit_occ_table
+inline std::vector<std::string> const occ_table_names{
+    "interleavedEPR16", "interleavedEPR32", "interleavedWavelet", "wavelet",
+    "compactWavelet", "bitvector", "compactBitvector"};
+
+// calls `f` with std::type_identity of the occurrence table named `name`,
+// returns false if there is no such table
+template <typename F>
+bool visit_occ_table(std::string_view name, F&& f) {
+    using namespace fmindex_collection::occtable;
+    if (name == "interleavedEPR16")   { f(std::type_identity<interleavedEPR16::OccTable<native_sigma>>{});   return true; }
+    if (name == "interleavedEPR32")   { f(std::type_identity<interleavedEPR32::OccTable<native_sigma>>{});   return true; }
+    if (name == "interleavedWavelet") { f(std::type_identity<interleavedWavelet::OccTable<native_sigma>>{}); return true; }
+    if (name == "wavelet")            { f(std::type_identity<wavelet::OccTable<native_sigma>>{});            return true; }
+    if (name == "compactWavelet")     { f(std::type_identity<compactWavelet::OccTable<native_sigma>>{});     return true; }
+    if (name == "bitvector")          { f(std::type_identity<bitvector::OccTable<native_sigma>>{});          return true; }
+    if (name == "compactBitvector")   { f(std::type_identity<compactBitvector::OccTable<native_sigma>>{});   return true; }
+    return false;
+}
+
+inline uint8_t native_symbol(seqan3::dna5 c) {
+    return seqan3::to_rank(c) + 1;
+}
+
+inline std::vector<std::vector<uint8_t>> to_native_text(std::vector<std::vector<seqan3::dna5>> const& reference) {
+    auto text = std::vector<std::vector<uint8_t>>{};
+    text.reserve(reference.size());
+    for (auto const& r : reference) {
+        auto& t = text.emplace_back();
+        t.reserve(r.size());
+        for (auto c : r) {
+            t.push_back(native_symbol(c));
+        }
+    }
+    return text;
+}
+
+// half open interval [lb, lb+len) of the suffix array
+struct NativeInterval {
+    size_t lb;
+    size_t len;
+
+    bool empty() const { return len == 0; }
+};
+
+template <typename index_t>
+NativeInterval full_interval(index_t const& index) {
+    return {0, index.size()};
+}
+
+// one backward search step, occ.rank already includes the C array
+template <typename index_t>
+NativeInterval extend_left(index_t const& index, NativeInterval iv, uint8_t symb) {
+    auto lb = index.occ.rank(iv.lb, symb);
+    return {lb, index.occ.rank(iv.lb + iv.len, symb) - lb};
+}
+
+// exact backward search over the whole query
+template <typename index_t, typename query_t>
+NativeInterval backward_search(index_t const& index, query_t const& query) {
+    auto iv = full_interval(index);
+    for (auto it = std::ranges::rbegin(query); it != std::ranges::rend(query) && !iv.empty(); ++it) {
+        iv = extend_left(index, iv, native_symbol(*it));
+    }
+    return iv;
+}
+
+// calls `report(reference_id, position)` for every entry of the interval
+template <typename index_t, typename report_t>
+void locate_interval(index_t const& index, NativeInterval iv, report_t&& report) {
+    for (size_t i = iv.lb; i < iv.lb + iv.len; ++i) {
+        auto [reference_id, position] = index.locate(i);
+        report(reference_id, position);
+    }
+}
+
+// backtracking with substitutions only, `report(interval, errors)` is called
+// for every interval that matches the query with at most `max_errors` errors
+template <typename index_t, typename query_t, typename report_t>
+void backtrack_hamming(index_t const& index, query_t const& query, uint8_t max_errors, report_t&& report) {
+    auto rec = [&](auto& self, NativeInterval iv, size_t remaining, uint8_t errors) -> void {
+        if (remaining == 0) {
+            report(iv, errors);
+            return;
+        }
+        auto expected = native_symbol(query[remaining - 1]);
+        for (uint8_t symb = 1; symb < native_sigma; ++symb) {
+            auto next_errors = errors + (symb != expected ? 1 : 0);
+            if (next_errors > max_errors) continue;
+            auto next = extend_left(index, iv, symb);
+            if (!next.empty()) {
+                self(self, next, remaining - 1, next_errors);
+            }
+        }
+    };
+    rec(rec, full_interval(index), std::ranges::size(query), 0);
+}
+
+// runs all searches of `schemes` on a bidirectional index with substitutions
+// only, `report(lb, count, errors)` is called for every matching interval
+template <typename index_t, typename query_t, typename report_t>
+void search_scheme_hamming(index_t const& index, query_t const& query, std::vector<SearchScheme> const& schemes, report_t&& report) {
+    using cursor_t = fmindex_collection::BiFMIndexCursor<index_t>;
+
+    auto const parts  = schemes.front().pi.size();
+    auto const starts = piece_starts(std::ranges::size(query), parts);
+
+    // a search is flattened into single steps, each step extends the cursor by
+    // one query position and knows the bounds of the piece it belongs to
+    struct Step {
+        size_t  position;
+        bool    right;
+        uint8_t l;
+        uint8_t u;
+        bool    piece_end;
+    };
+    auto steps = std::vector<Step>{};
+
+    for (auto const& scheme : schemes) {
+        steps.clear();
+        // the first piece is searched left to right, afterwards pieces right
+        // of the covered part are extended to the right, the others to the left
+        auto highest = scheme.pi.front();
+        for (size_t j = 0; j < parts; ++j) {
+            auto piece = scheme.pi[j];
+            bool right = j == 0 || piece > highest;
+            highest = std::max(highest, piece);
+            for (size_t k = 0; k < starts[piece + 1] - starts[piece]; ++k) {
+                auto position = right ? starts[piece] + k : starts[piece + 1] - 1 - k;
+                steps.push_back({position, right, scheme.l[j], scheme.u[j], k + 1 == starts[piece + 1] - starts[piece]});
+            }
+        }
+
+        auto rec = [&](auto& self, cursor_t const& cur, size_t step, uint8_t errors) -> void {
+            if (step == steps.size()) {
+                report(cur.lb, cur.count(), errors);
+                return;
+            }
+            auto const& s = steps[step];
+            auto expected = native_symbol(query[s.position]);
+            for (uint8_t symb = 1; symb < native_sigma; ++symb) {
+                auto next_errors = errors + (symb != expected ? 1 : 0);
+                if (next_errors > s.u || (s.piece_end && next_errors < s.l)) continue;
+                auto next = s.right ? cur.extendRight(symb) : cur.extendLeft(symb);
+                if (!next.empty()) {
+                    self(self, next, step + 1, next_errors);
+                }
+            }
+        };
+        rec(rec, cursor_t{index}, 0, 0);
+    }
+}
+
+#endif
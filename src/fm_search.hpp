@@ -0,0 +1,352 @@
+#ifndef FM_SEARCH_HPP
+#define FM_SEARCH_HPP
+
+#include "batched_search.hpp"
+#include "chunk_scheduler.hpp"
+#include "fm_native.hpp"
+#include "index_file.hpp"
+#include "kmer_table.hpp"
+#include "query_trie.hpp"
+#include "result_sink.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <ranges>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <seqan3/search/search.hpp>
+
+// knobs shared by all fm-index searches
+struct SearchOptions {
+    size_t        interleave = 1;    // number of exact native searches advanced together, see batched_search.hpp
+    size_t        threads    = 1;
+    size_t        chunk_size = 4096; // queries per chunk of the scheduler, see chunk_scheduler.hpp
+    bool          trie       = false; // search chunks of queries as a trie on native unidirectional indices, see query_trie.hpp
+    LocateOptions locate;            // count only or cap the located positions per query
+
+    // latencies, both are called on the thread that searched, possibly
+    // concurrently, and only if set: `query_timer(duration)` with the time of
+    // every query of a native search that handles one query at a time, see
+    // native_per_query, `chunk_timer(duration, query_count)` with the time of
+    // every chunk of chunk_size queries otherwise. Reporting is not timed.
+    std::function<void(std::chrono::nanoseconds)>         query_timer;
+    std::function<void(std::chrono::nanoseconds, size_t)> chunk_timer;
+};
+
+// whether native_intervals searches the queries one after another, the
+// trie and interleaved searches advance a whole chunk of them together
+template <typename index_t>
+bool native_per_query(uint8_t max_errors, SearchOptions const& options) {
+    if constexpr (is_native_bi_index<index_t>) {
+        return true;
+    } else {
+        return !options.trie && !(max_errors == 0 && options.interleave > 1 && index_can_prefetch<index_t>);
+    }
+}
+
+// calls `f(query_id, intervals)` with the distinct intervals matching each
+// query with at most `max_errors` substitutions. All matches have the length
+// of the query, so distinct intervals never share an occurrence. Exact
+// searches on unidirectional indices start from the k-mer table if present,
+// unless options.trie walks a trie of up to chunk_size queries at a time.
+template <typename index_t, typename queries_t, typename f_t>
+void native_intervals(index_t const& index, queries_t const& queries, uint8_t max_errors, f_t&& f,
+                      KmerTable const* kmer_table, SearchOptions const& options) {
+    auto intervals = std::vector<NativeInterval>{};
+
+    if constexpr (!is_native_bi_index<index_t>) {
+        if (options.trie) {
+            auto trie  = QueryTrie{};
+            auto found = std::vector<std::pair<size_t, NativeInterval>>{};
+            auto const query_count = std::ranges::size(queries);
+            for (size_t begin = 0; begin < query_count; begin += options.chunk_size) {
+                auto const end = std::min(query_count, begin + options.chunk_size);
+                trie.build(std::ranges::subrange(std::ranges::begin(queries) + begin, std::ranges::begin(queries) + end));
+                found.clear();
+                trie_search(index, trie, max_errors, [&](size_t query_id, NativeInterval iv) {
+                    found.emplace_back(query_id, iv);
+                });
+
+                // the walk finds the intervals in index order, f gets them per query
+                std::ranges::sort(found, {}, [](auto const& result) { return result.first; });
+                auto next = found.begin();
+                for (size_t query_id = 0; query_id < end - begin; ++query_id) {
+                    intervals.clear();
+                    for (; next != found.end() && next->first == query_id; ++next) {
+                        intervals.push_back(next->second);
+                    }
+                    f(begin + query_id, intervals);
+                }
+            }
+            return;
+        }
+        if constexpr (index_can_prefetch<index_t>) {
+            if (max_errors == 0 && options.interleave > 1) {
+                auto results = std::vector<NativeInterval>(std::ranges::size(queries));
+                batched_backward_search(index, queries, options.interleave, [&](size_t query_id, NativeInterval iv) {
+                    results[query_id] = iv;
+                }, kmer_table);
+                for (size_t query_id = 0; query_id < results.size(); ++query_id) {
+                    intervals.assign(1, results[query_id]);
+                    f(query_id, intervals);
+                }
+                return;
+            }
+        }
+    }
+
+    auto const schemes = optimum_search_scheme(max_errors);
+    size_t query_id = 0;
+    for (auto const& query : queries) {
+        intervals.clear();
+        if constexpr (is_native_bi_index<index_t>) {
+            // several searches of a scheme may find the same match
+            search_scheme_hamming(index, query, schemes, [&](size_t lb, size_t count, uint8_t) {
+                if (count > 0) intervals.push_back({lb, count});
+            });
+            std::ranges::sort(intervals, {}, [](NativeInterval iv) { return iv.lb; });
+            auto [first, last] = std::ranges::unique(intervals, {}, [](NativeInterval iv) { return iv.lb; });
+            intervals.erase(first, last);
+        } else if (max_errors == 0) {
+            intervals.push_back(kmer_table && !kmer_table->empty() ? kmer_table->backward_search(index, query) : backward_search(index, query));
+        } else {
+            backtrack_hamming(index, query, max_errors, [&](NativeInterval iv, uint8_t) {
+                intervals.push_back(iv);
+            });
+        }
+        f(query_id, intervals);
+        ++query_id;
+    }
+}
+
+// searches every query on a native index, `report(query_id, reference_id, position)`
+// is called for every hit, sorted by position per query. Errors are
+// substitutions only. With options.locate.max_hits only that many
+// occurrences per query are located.
+template <typename index_t, typename queries_t, typename report_t>
+void native_search(index_t const& index, queries_t const& queries, uint8_t max_errors, report_t&& report,
+                   KmerTable const* kmer_table = nullptr, SearchOptions const& options = {}) {
+    auto const max_hits = options.locate.max_hits ? options.locate.max_hits : std::numeric_limits<size_t>::max();
+    auto hits = std::vector<std::pair<size_t, size_t>>{};
+    // the queries are searched one after another, a query starts when the
+    // previous one is reported
+    bool const time_queries = options.query_timer && native_per_query<index_t>(max_errors, options);
+    auto query_start = std::chrono::steady_clock::now();
+    native_intervals(index, queries, max_errors, [&](size_t query_id, std::vector<NativeInterval> const& intervals) {
+        hits.clear();
+        for (auto iv : intervals) {
+            iv.len = std::min(iv.len, max_hits - hits.size());
+            locate_interval(index, iv, [&](size_t reference_id, size_t position) {
+                hits.emplace_back(reference_id, position);
+            });
+            if (hits.size() == max_hits) break;
+        }
+        std::ranges::sort(hits);
+        if (time_queries) {
+            options.query_timer(std::chrono::steady_clock::now() - query_start);
+        }
+        for (auto [reference_id, position] : hits) {
+            report(query_id, reference_id, position);
+        }
+        if (time_queries) {
+            query_start = std::chrono::steady_clock::now();
+        }
+    }, kmer_table, options);
+}
+
+// counts the occurrences of every query on a native index without locating
+// them, `report(query_id, count)` is called once per query
+template <typename index_t, typename queries_t, typename report_t>
+void native_count(index_t const& index, queries_t const& queries, uint8_t max_errors, report_t&& report,
+                  KmerTable const* kmer_table = nullptr, SearchOptions const& options = {}) {
+    bool const time_queries = options.query_timer && native_per_query<index_t>(max_errors, options);
+    auto query_start = std::chrono::steady_clock::now();
+    native_intervals(index, queries, max_errors, [&](size_t query_id, std::vector<NativeInterval> const& intervals) {
+        size_t count = 0;
+        for (auto iv : intervals) {
+            count += iv.len;
+        }
+        if (time_queries) {
+            options.query_timer(std::chrono::steady_clock::now() - query_start);
+        }
+        report(query_id, count);
+        if (time_queries) {
+            query_start = std::chrono::steady_clock::now();
+        }
+    }, kmer_table, options);
+}
+
+// runs `search(chunk, chunk_report)` on subranges of the queries with the
+// chunk scheduler if several threads search or the chunks are `timed` by
+// options.chunk_timer, otherwise `search(queries, report)` once.
+// `chunk_report(query_id, values...)` takes ids relative to the chunk and
+// buffers them as `result_t` (a tuple of the global id and the values),
+// `report(query_id, values...)` is then called outside of the search and
+// never concurrently.
+template <typename result_t, typename queries_t, typename search_t, typename report_t>
+void search_chunks(queries_t&& queries, SearchOptions const& options, bool timed, search_t&& search, report_t&& report) {
+    if (options.threads <= 1 && !timed) {
+        search(queries, report);
+        return;
+    }
+    auto mutex = std::mutex{};
+    parallel_chunks(std::ranges::size(queries), options.chunk_size, options.threads, [&](size_t, size_t begin, size_t end) {
+        auto const start = std::chrono::steady_clock::now();
+        auto chunk   = std::ranges::subrange(std::ranges::begin(queries) + begin, std::ranges::begin(queries) + end);
+        auto results = std::vector<result_t>{};
+        search(chunk, [&](size_t query_id, auto... values) {
+            results.emplace_back(begin + query_id, values...);
+        });
+        if (timed) {
+            options.chunk_timer(std::chrono::steady_clock::now() - start, end - begin);
+        }
+
+        std::lock_guard lock{mutex};
+        for (auto const& result : results) {
+            std::apply(report, result);
+        }
+    });
+}
+
+// calls `f(query_id, cursor)` for every cursor seqan3::search finds on a seqan3 index
+template <typename index_t, typename queries_t, typename f_t>
+void seqan3_cursors(index_t const& index, queries_t&& queries, uint8_t max_errors, SearchOptions const& options, f_t&& f) {
+    auto run = [&](auto const& cfg) {
+        for (auto && result : seqan3::search(queries, index, cfg)) {
+            f(result.query_id(), result.index_cursor());
+        }
+    };
+    seqan3::configuration const cfg = seqan3::search_cfg::max_error_total{seqan3::search_cfg::error_count{max_errors}}
+                                    | seqan3::search_cfg::output_query_id{}
+                                    | seqan3::search_cfg::output_index_cursor{};
+    if (options.threads > 1) {
+        run(cfg | seqan3::search_cfg::parallel{static_cast<uint32_t>(options.threads)});
+    } else {
+        run(cfg);
+    }
+}
+
+// searches all queries in a seqan3 index, `report(query_id, reference_id, position)`
+// is called for every hit, with options.locate.max_hits sorted per query
+template <typename index_t, typename queries_t, typename report_t>
+void seqan3_search(index_t const& index, queries_t&& queries, uint8_t max_errors, report_t&& report, SearchOptions const& options) {
+    if (options.locate.max_hits > 0) {
+        // locate at most max_hits positions from the cursors of a query, with
+        // indels different cursors may locate the same position
+        auto hits    = std::vector<std::tuple<size_t, size_t, size_t>>{};
+        auto located = std::vector<size_t>(std::ranges::size(queries));
+        seqan3_cursors(index, queries, max_errors, options, [&](size_t query_id, auto const& cursor) {
+            for (auto [reference_id, position] : cursor.lazy_locate()) {
+                if (located[query_id] == options.locate.max_hits) break;
+                hits.emplace_back(query_id, reference_id, position);
+                ++located[query_id];
+            }
+        });
+        std::ranges::sort(hits);
+        auto [first, last] = std::ranges::unique(hits);
+        hits.erase(first, last);
+        for (auto [query_id, reference_id, position] : hits) {
+            report(query_id, reference_id, position);
+        }
+        return;
+    }
+    auto run = [&](auto const& cfg) {
+        for (auto && result : seqan3::search(queries, index, cfg)) {
+            report(result.query_id(), result.reference_id(), result.reference_begin_position());
+        }
+    };
+    seqan3::configuration const cfg = seqan3::search_cfg::max_error_total{seqan3::search_cfg::error_count{max_errors}};
+    if (options.threads > 1) {
+        run(cfg | seqan3::search_cfg::parallel{static_cast<uint32_t>(options.threads)});
+    } else {
+        run(cfg);
+    }
+}
+
+// counts the occurrences of all queries in a seqan3 index, `report(query_id, count)`
+// is called once per query and in order. Several cursors of a query may point
+// to the same suffix array interval, each interval is counted once.
+template <typename index_t, typename queries_t, typename report_t>
+void seqan3_count(index_t const& index, queries_t&& queries, uint8_t max_errors, report_t&& report, SearchOptions const& options) {
+    auto intervals = std::vector<std::tuple<size_t, size_t, size_t, size_t>>{};
+    seqan3_cursors(index, queries, max_errors, options, [&](size_t query_id, auto const& cursor) {
+        auto interval = cursor.suffix_array_interval();
+        intervals.emplace_back(query_id, interval.begin_position, interval.end_position, cursor.count());
+    });
+    std::ranges::sort(intervals);
+    auto [first, last] = std::ranges::unique(intervals);
+    intervals.erase(first, last);
+    auto counts = std::vector<size_t>(std::ranges::size(queries));
+    for (auto [query_id, begin, end, count] : intervals) {
+        counts[query_id] += count;
+    }
+    for (size_t query_id = 0; query_id < counts.size(); ++query_id) {
+        report(query_id, counts[query_id]);
+    }
+}
+
+// searches all queries in any index produced by visit_index,
+// `report(query_id, reference_id, position)` is called for every hit, never
+// concurrently. seqan3 indices allow all kinds of errors, native ones only
+// substitutions. With several threads seqan3 indices use seqan3's own
+// parallel search, native ones the chunk scheduler; with a chunk_timer
+// seqan3 indices search the chunks of the scheduler one thread each.
+template <typename index_t, typename queries_t, typename report_t>
+void fm_search(index_t const& index, queries_t&& queries, uint8_t max_errors, report_t&& report,
+               IndexExtras const& extras, SearchOptions const& options = {}) {
+    using result_t = std::tuple<size_t, size_t, size_t>;
+    if constexpr (is_native_index<index_t>) {
+        bool const timed = options.chunk_timer && !native_per_query<index_t>(max_errors, options);
+        search_chunks<result_t>(queries, options, timed, [&](auto const& chunk, auto&& chunk_report) {
+            native_search(index, chunk, max_errors, chunk_report, &extras.kmer_table, options);
+        }, report);
+    } else if (options.chunk_timer) {
+        auto chunk_options = options;
+        chunk_options.threads = 1;
+        search_chunks<result_t>(queries, options, true, [&](auto const& chunk, auto&& chunk_report) {
+            seqan3_search(index, chunk, max_errors, chunk_report, chunk_options);
+        }, report);
+    } else {
+        seqan3_search(index, queries, max_errors, report, options);
+    }
+}
+
+// counts the occurrences of all queries in any index produced by visit_index
+// without locating them, `report(query_id, count)` is called once per query,
+// in order and never concurrently. For seqan3 indices with errors the count is
+// the number of occurrences of the distinct matching strings, with indels an
+// occurrence may therefore be counted more than once.
+template <typename index_t, typename queries_t, typename report_t>
+void fm_count(index_t const& index, queries_t&& queries, uint8_t max_errors, report_t&& report,
+              IndexExtras const& extras, SearchOptions const& options = {}) {
+    using result_t = std::tuple<size_t, size_t>;
+    auto counts = std::vector<size_t>(std::ranges::size(queries));
+    auto collect = [&](size_t query_id, size_t count) {
+        counts[query_id] = count;
+    };
+    if constexpr (is_native_index<index_t>) {
+        bool const timed = options.chunk_timer && !native_per_query<index_t>(max_errors, options);
+        search_chunks<result_t>(queries, options, timed, [&](auto const& chunk, auto&& chunk_report) {
+            native_count(index, chunk, max_errors, chunk_report, &extras.kmer_table, options);
+        }, collect);
+    } else if (options.chunk_timer) {
+        auto chunk_options = options;
+        chunk_options.threads = 1;
+        search_chunks<result_t>(queries, options, true, [&](auto const& chunk, auto&& chunk_report) {
+            seqan3_count(index, chunk, max_errors, chunk_report, chunk_options);
+        }, collect);
+    } else {
+        seqan3_count(index, queries, max_errors, collect, options);
+    }
+    for (size_t query_id = 0; query_id < counts.size(); ++query_id) {
+        report(query_id, counts[query_id]);
+    }
+}
+
+#endif
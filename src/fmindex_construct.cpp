@@ -1,10 +1,15 @@
 #include "benchmark.hpp"
+#include "index_file.hpp"
+#include "reference_text.hpp"
+#include "sharded_index.hpp"
+#include <limits>
 #include <sstream>
 
 #include <seqan3/alphabet/nucleotide/dna5.hpp>
 #include <seqan3/argument_parser/all.hpp>
 #include <seqan3/core/debug_stream.hpp>
 #include <seqan3/io/sequence_file/all.hpp>
+#include <seqan3/search/fm_index/bi_fm_index.hpp>
 #include <seqan3/search/fm_index/fm_index.hpp>
 #include <seqan3/search/search.hpp>
 
@@ -20,33 +25,216 @@ int main(int argc, char const* const* argv) {
     auto index_path = std::filesystem::path{};
     parser.add_option(index_path, '\0', "index", "path to the query file");
 
+    auto bidirectional = false;
+    parser.add_flag(bidirectional, '\0', "bidirectional", "build a bidirectional index, approximate searches then use search schemes");
+
+    auto backend = std::string{"seqan3"};
+    parser.add_option(backend, '\0', "backend", "library that builds the index, seqan3 or native (fmindex-collection)",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{std::vector<std::string>{"seqan3", "native"}});
+
+    auto occ_table = std::string{"interleavedEPR16"};
+    parser.add_option(occ_table, '\0', "occ", "occurrence table of the native backend",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{occ_table_names});
+
+    auto kmer_length = uint8_t{0};
+    parser.add_option(kmer_length, '\0', "kmer-table", "store the intervals of all k-mers of this length (native unidirectional index only, 0 = none), the table takes 8 * 4^k bytes",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{0, 12});
+
+    auto sa_sampling = uint32_t{16};
+    parser.add_option(sa_sampling, '\0', "sa-sampling", "store every n-th suffix array entry, smaller values locate faster but need more memory (the seqan3 backend only supports 16)",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1024});
+
+    auto shard_size = uint64_t{0};
+    parser.add_option(shard_size, '\0', "shard-size", "split the references into shards of at most this many bases, each with its own index file next to a manifest at --index (0 = one index)");
+
+    auto append = false;
+    parser.add_flag(append, '\0', "append", "add the references as new shards to the index at --index, a single index becomes the first shard; "
+                                         "the new shards use the settings of the existing index");
+
+    auto store_text = false;
+    parser.add_flag(store_text, '\0', "store-text", "also store the packed references in the index, fmindex_pigeon_search then needs no --reference; "
+                                                 "not with --shard-size or --append, fmindex_pigeon_search can not search sharded indices");
+
     try {
          parser.parse();
     } catch (seqan3::argument_parser_error const& ext) {
         seqan3::debug_stream << "Parsing error. " << ext.what() << "\n";
         return EXIT_FAILURE;
     }
+    // Appending never touches the existing indices, the new references get
+    // shards of their own whose reference ids continue those of the index.
+    auto manifest = ShardManifest{};
+    auto convert_to_shards = false; // the existing index is a single index that becomes shard 0
+    if (append) {
+        if (!std::filesystem::exists(index_path)) {
+            seqan3::debug_stream << "--append requires an existing index at --index\n";
+            return EXIT_FAILURE;
+        }
+        auto existing = IndexHeader{};
+        if (is_sharded_index(index_path)) {
+            manifest = read_manifest(index_path);
+            if (manifest.shards.empty()) {
+                seqan3::debug_stream << "--append requires a manifest with at least one shard\n";
+                return EXIT_FAILURE;
+            }
+            existing = read_index_header(shard_path(index_path, manifest.shards.front()));
+        } else {
+            existing = read_index_header(index_path);
+            if (existing.version < 5) {
+                seqan3::debug_stream << "--append requires an index that stores its number of references, rebuild it first\n";
+                return EXIT_FAILURE;
+            }
+            manifest.shards.push_back({shard_file_name(index_path, 0), 0, existing.reference_count, existing.reference_length});
+            convert_to_shards = true;
+        }
+        bidirectional = existing.bidirectional;
+        backend       = existing.backend == IndexBackend::native ? "native" : "seqan3";
+        occ_table     = existing.backend == IndexBackend::native ? existing.occ_table : occ_table;
+        kmer_length   = existing.kmer_length;
+        sa_sampling   = existing.sa_sampling;
+        store_text    = existing.stored_text;
+        if (shard_size == 0) {
+            shard_size = std::numeric_limits<uint64_t>::max(); // all new references in one shard
+        }
+    }
+
+    if (kmer_length > 0 && (backend != "native" || bidirectional)) {
+        seqan3::debug_stream << "--kmer-table requires --backend native without --bidirectional\n";
+        return EXIT_FAILURE;
+    }
+    if (sa_sampling != 16 && backend != "native") {
+        // the sampling of seqan3::fm_index is part of its sdsl type and fixed to 16
+        seqan3::debug_stream << "--sa-sampling other than 16 requires --backend native\n";
+        return EXIT_FAILURE;
+    }
+    if (store_text && shard_size > 0) {
+        // every shard would store its own references, but no tool reads them through a manifest
+        seqan3::debug_stream << "--store-text can not be combined with --shard-size or --append\n";
+        return EXIT_FAILURE;
+    }
 
     // loading our files
     auto reference_stream = seqan3::sequence_file_input{reference_file};
 
-    // read reference into memory
+    // read reference into memory, a sharded index reads it shard by shard below
     std::vector<std::vector<seqan3::dna5>> reference;
-    for (auto& record : reference_stream) {
-        reference.push_back(record.sequence());
+    if (shard_size == 0) {
+        for (auto& record : reference_stream) {
+            reference.push_back(record.sequence());
+        }
     }
-    auto benchmark = Benchmark("fmindex_construct", reference_file, "", 0);
-    // Our index is of type `Index`
-    seqan3::fm_index index{reference}; // construct fm-index
-    benchmark.write(0);
+
     // saving the fmindex to storage
-    {
+    auto header = IndexHeader{.bidirectional = bidirectional, .sa_sampling = sa_sampling, .stored_text = store_text};
+    if (backend == "native") {
+        header.backend   = IndexBackend::native;
+        header.occ_table = occ_table;
+        header.kmer_length = kmer_length;
+    }
+    auto save = [&](std::filesystem::path const& path, auto const& index, KmerTable const* kmer_table = nullptr) {
         seqan3::debug_stream << "Saving 2FM-Index ... " << std::flush;
-        std::ofstream os{index_path, std::ios::binary};
+        std::ofstream os{path, std::ios::binary};
         cereal::BinaryOutputArchive oarchive{os};
+        write_index_header(os, oarchive, header);
         oarchive(index);
+        if (kmer_table) {
+            oarchive(*kmer_table);
+        }
+        if (store_text) {
+            write_reference_text(os, reference);
+        }
         seqan3::debug_stream << "done\n";
+    };
+
+    auto method = std::string{bidirectional ? "bi_fmindex_construct" : "fmindex_construct"};
+    if (header.backend == IndexBackend::native) {
+        method += "_" + occ_table + "_sa" + std::to_string(sa_sampling);
+    }
+    if (append) {
+        method += "_append";
+    } else if (shard_size > 0) {
+        method += "_sharded";
+    }
+    auto benchmark = Benchmark(method, reference_file, "", 0);
+    size_t built = 0; // number of indices built so far
+
+    // builds the index of `reference` and saves it at `path`
+    auto build = [&](std::filesystem::path const& path) {
+        benchmark.phase("load_reference"); // of this shard for a sharded index
+        header.reference_count  = reference.size();
+        header.reference_length = 0;
+        for (auto const& sequence : reference) {
+            header.reference_length += sequence.size();
+        }
+        if (header.backend == IndexBackend::native) {
+            auto text = to_native_text(reference);
+            visit_occ_table(occ_table, [&]<typename occ_t>(std::type_identity<occ_t>) {
+                if (bidirectional) {
+                    auto index = NativeBiIndex<occ_t>{text, /*samplingRate=*/sa_sampling, /*threadNbr=*/1};
+                    benchmark.write(built);
+                    benchmark.phase("build_index");
+                    save(path, index);
+                } else {
+                    auto index = NativeIndex<occ_t>{text, /*samplingRate=*/sa_sampling, /*threadNbr=*/1};
+                    auto kmer_table = KmerTable{};
+                    if (kmer_length > 0) {
+                        kmer_table.build(index, kmer_length);
+                    }
+                    benchmark.write(built);
+                    benchmark.phase("build_index");
+                    save(path, index, kmer_length > 0 ? &kmer_table : nullptr);
+                }
+            });
+        } else if (bidirectional) {
+            seqan3::bi_fm_index index{reference}; // construct bidirectional fm-index
+            benchmark.write(built);
+            benchmark.phase("build_index");
+            save(path, index);
+        } else {
+            // Our index is of type `Index`
+            seqan3::fm_index index{reference}; // construct fm-index
+            benchmark.write(built);
+            benchmark.phase("build_index");
+            save(path, index);
+        }
+        benchmark.phase("save_index");
+        ++built;
+    };
+
+    if (shard_size == 0) {
+        build(index_path);
+        return 0;
+    }
+
+    // Sharded index: the references are read in order and a shard is built
+    // as soon as the next reference would exceed --shard-size, so only one
+    // shard is in memory at a time. References are never split, a reference
+    // longer than --shard-size gets a shard of its own.
+    auto shard = ShardInfo{.first_reference = manifest.reference_count()};
+    auto build_shard = [&] {
+        shard.file            = shard_file_name(index_path, manifest.shards.size());
+        shard.reference_count = reference.size();
+        build(shard_path(index_path, shard));
+        manifest.shards.push_back(shard);
+        shard = ShardInfo{.first_reference = manifest.reference_count()};
+        reference.clear();
+    };
+    for (auto& record : reference_stream) {
+        auto sequence = record.sequence();
+        if (!reference.empty() && shard.length + sequence.size() > shard_size) {
+            build_shard();
+        }
+        shard.length += sequence.size();
+        reference.push_back(std::move(sequence));
+    }
+    if (!reference.empty()) {
+        build_shard();
+    }
+    if (convert_to_shards) {
+        std::filesystem::rename(index_path, shard_path(index_path, manifest.shards.front()));
     }
+    write_manifest(index_path, manifest);
+    seqan3::debug_stream << "Wrote manifest of " << manifest.shards.size() << " shards\n";
 
     return 0;
 }
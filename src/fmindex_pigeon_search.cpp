@@ -1,8 +1,10 @@
 #include <sstream>
 #include <ranges>
 #include <algorithm>
-#include <tuple>
-#include <unordered_set>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <string>
 
 #include <seqan3/alphabet/nucleotide/dna5.hpp>
 #include <seqan3/argument_parser/all.hpp>
@@ -12,26 +14,17 @@
 #include <seqan3/search/search.hpp>
 
 #include "benchmark.hpp"
-
-struct match_hash { 
-  size_t operator()(const std::tuple<int, int, int> &val) const { 
-    return std::get<0>(val) ^ std::get<1>(val) ^ std::get<2>(val); 
-  } 
-}; 
-
-bool verify(std::vector<seqan3::dna5> const& ref, std::vector<seqan3::dna5> const& query, int start_position, int max_mismatches) {
-    int mismatches = 0;
-    for (auto j = 0; j < query.size(); j++) {
-	if (mismatches > max_mismatches)
-		break;
-
-	if (ref[start_position+j] != query[j]) {
-		mismatches++;
-	}
-    }
-
-    return mismatches <= max_mismatches;
-}
+#include "chunk_scheduler.hpp"
+#include "fm_search.hpp"
+#include "index_file.hpp"
+#include "pigeon_candidates.hpp"
+#include "pigeon_search.hpp"
+#include "query_dedup.hpp"
+#include "query_pipeline.hpp"
+#include "reference_text.hpp"
+#include "result_sink.hpp"
+#include "search_schemes.hpp"
+#include "strands.hpp"
 
 int main(int argc, char const* const* argv) {
     seqan3::argument_parser parser{"fmindex_pigeon_search", argc, argv, seqan3::update_notifications::off};
@@ -43,7 +36,7 @@ int main(int argc, char const* const* argv) {
     parser.add_option(index_path, '\0', "index", "path to the query file");
 
     auto reference_file = std::filesystem::path{};
-    parser.add_option(reference_file, '\0', "reference", "path to the reference file");
+    parser.add_option(reference_file, '\0', "reference", "path to the reference file, not needed if the index was built with --store-text");
 
     auto query_file = std::filesystem::path{};
     parser.add_option(query_file, '\0', "query", "path to the query file");
@@ -52,124 +45,230 @@ int main(int argc, char const* const* argv) {
     parser.add_option(number_of_queries, '\0', "query_ct", "number of query, if not enough queries, these will be duplicated");
 
     auto number_of_errors = uint8_t{0};
-    parser.add_option(number_of_errors, '\0', "errors", "number of allowed hamming distance errors");
+    parser.add_option(number_of_errors, '\0', "errors", "number of allowed errors, see --error-model");
+
+    auto error_model = std::string{"hamming"};
+    parser.add_option(error_model, '\0', "error-model", "hamming (mismatches only) or edit (mismatches and indels, candidates are verified by a banded alignment)",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{std::vector<std::string>{"hamming", "edit"}});
 
     auto quiet = false;
     parser.add_option(quiet, '\0', "quiet", "do not print matches");
 
+    auto options = SearchOptions{};
+    parser.add_option(options.interleave, '\0', "interleave", "number of exact searches on a native index that are advanced together with prefetching, needs an occurrence table that can prefetch",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1024});
+    parser.add_option(options.threads, '\0', "threads", "number of threads used for searching, reads are distributed by a work stealing scheduler",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1024});
+
+    auto output_file = std::filesystem::path{"-"};
+    parser.add_option(output_file, '\0', "output", "file the matches are written to, - for stdout");
+
+    auto format_name = std::string{"sam"};
+    parser.add_option(format_name, '\0', "format", "output format of the matches, sam or binary",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{result_format_names});
+
+    parser.add_flag(options.locate.count_only, '\0', "count-only", "only report the number of occurrences per read");
+    parser.add_option(options.locate.max_hits, '\0', "max-hits", "report at most this many occurrences per read, 0 reports all");
+
+    auto batch_size = size_t{64};
+    parser.add_option(batch_size, '\0', "batch-size", "number of reads whose pieces are searched together, with --interleave on a native index their backward searches are interleaved",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1 << 20});
+
+    auto partition = std::string{"equal"};
+    parser.add_option(partition, '\0', "partition", "how reads are split into pieces, equal or adaptive (moves the boundaries so the pieces occur as rarely as possible, using count queries)",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{std::vector<std::string>{"equal", "adaptive"}});
+
+    auto extra_piece = false;
+    parser.add_flag(extra_piece, '\0', "extra-piece", "split reads into errors + 2 pieces, a candidate then needs two exactly matching pieces");
+
+    auto both = false;
+    parser.add_flag(both, '\0', "both-strands", "also search the reverse complement of every read, its pieces are searched together with the forward ones; --max-hits applies to each strand");
+
+    auto stream = false;
+    parser.add_flag(stream, '\0', "stream", "search while reading the queries instead of loading all of them first");
+
+    auto use_dedup = false;
+    parser.add_flag(use_dedup, '\0', "dedup", "search every distinct read once and report its results for all reads with the same sequence (not with --stream)");
+
     try {
          parser.parse();
     } catch (seqan3::argument_parser_error const& ext) {
         seqan3::debug_stream << "Parsing error. " << ext.what() << "\n";
         return EXIT_FAILURE;
     }
+    if (use_dedup && stream) {
+        seqan3::debug_stream << "--dedup needs all queries in memory and does not support --stream\n";
+        return EXIT_FAILURE;
+    }
+    if (options.interleave > 1) {
+        // the interleaved search hides the occ lookups behind prefetches, see batched_search.hpp
+        auto const header = read_index_header(index_path);
+        if (header.backend == IndexBackend::native && !occ_table_can_prefetch(header.occ_table)) {
+            seqan3::debug_stream << "--interleave needs an occurrence table that can prefetch, " << header.occ_table << " cannot\n";
+            return EXIT_FAILURE;
+        }
+    }
 
-    // loading our files
-    auto reference_stream = seqan3::sequence_file_input{reference_file};
-    auto query_stream     = seqan3::sequence_file_input{query_file};
+    // the phases of the run are written to cpp_benchmark_phases.csv
+    auto load_benchmark = Benchmark("fmindex_pigeon_load", reference_file.empty() ? index_path : reference_file, query_file, number_of_errors);
 
-    // read reference into memory
-    std::vector<std::vector<seqan3::dna5>> reference;
-    for (auto& record : reference_stream) {
-        reference.push_back(record.sequence());
+    // the reference, 2-bit packed for the verification of candidates; an index
+    // that stores it is mapped instead of parsing the FASTA file again
+    auto const stored_text = read_index_header(index_path).stored_text;
+    if (reference_file.empty() && !stored_text) {
+        seqan3::debug_stream << "--reference is required unless the index was built with --store-text\n";
+        return EXIT_FAILURE;
     }
+    auto const reference = reference_file.empty() ? ReferenceText::from_index(index_path)
+                                                  : ReferenceText::from_fasta(reference_file);
+    load_benchmark.phase("load_reference");
 
-    // read query into memory
+    // read query into memory, unless they are streamed during the search
     std::vector<std::vector<seqan3::dna5>> queries;
-    for (auto& record : query_stream) {
-        queries.push_back(record.sequence());
+    if (!stream) {
+        auto query_stream = seqan3::sequence_file_input{query_file};
+        for (auto& record : query_stream) {
+            queries.push_back(record.sequence());
+        }
+
+        // duplicate input until its large enough
+        while (queries.size() < number_of_queries) {
+            auto old_count = queries.size();
+            queries.resize(2 * old_count);
+            std::copy_n(queries.begin(), old_count, queries.begin() + old_count);
+        }
+        queries.resize(number_of_queries); // will reduce the amount of searches
     }
 
-    // loading fm-index into memory
-    using Index = decltype(seqan3::fm_index{std::vector<std::vector<seqan3::dna5>>{}}); // Some hack
-    Index index; // construct fm-index
-    {
-        seqan3::debug_stream << "Loading 2FM-Index ... " << std::flush;
-        std::ifstream is{index_path, std::ios::binary};
-        cereal::BinaryInputArchive iarchive{is};
-        iarchive(index);
-        seqan3::debug_stream << "done\n";
+    // with --dedup only the distinct reads are searched, their results are
+    // reported for all of their copies, see query_dedup.hpp
+    auto dedup = QueryDedup{};
+    if (use_dedup) {
+        dedup = dedup_queries(queries);
     }
-
-    // duplicate input until its large enough
-    while (queries.size() < number_of_queries) {
-        auto old_count = queries.size();
-        queries.resize(2 * old_count);
-        std::copy_n(queries.begin(), old_count, queries.begin() + old_count);
-    }
-    queries.resize(number_of_queries); // will reduce the amount of searches
-
-    seqan3::configuration const cfg = seqan3::search_cfg::max_error_total{seqan3::search_cfg::error_count{0}};
-
-    auto benchmark = Benchmark("fmindex_pigeon", reference_file, query_file, number_of_errors);
-
-    int read_num = 0;
-    for (auto& query : queries) {
-	std::unordered_set<std::tuple<int, int, int>, match_hash> match_results;
-	int piece_size = query.size()/(number_of_errors+1);
-	int first_offset = query.size() % (number_of_errors+1);
-	std::vector<std::span<seqan3::dna5>> pieces;
-	for (auto i = 0; i < (number_of_errors+1); i++) {
-		int start;
-		int end;
-		if (i == 0) {
-			start = i*piece_size;
-			end=piece_size+first_offset;
-		} else {
-			start = (i*piece_size)+first_offset;
-			end=piece_size;
-		}
-		auto piece = std::views::counted(query.begin()+start, end);
-		pieces.push_back(piece);
-	}
-	auto results = seqan3::search(pieces, index, cfg);
-
-    	for (auto && result : results) {
-		match_results.insert(std::make_tuple(result.reference_begin_position(), result.query_id(), result.reference_id()));
-	}
-
-	for (auto& [match_position, piece_id, reference_id] : match_results) {
-		// if we cannot have possibly found a match within reference bounds then skip
-		if ( ((match_position - ((piece_id*piece_size)+first_offset)) < 0) || (match_position + (piece_id*piece_size)+first_offset > reference[reference_id].size())) {
-			continue;
-		}
-
-		int matched_pieces = 0;
-		for (auto i=0; i < piece_id; i++) {
-			int offset = piece_size * (piece_id - i);
-			if (i == 0)
-				offset += first_offset;
-			
-			if (match_results.contains(std::make_tuple(match_position-offset, i, reference_id))) {
-				matched_pieces++;
-			} 
-		}
-
-		for (auto i=piece_id+1; i < pieces.size(); i++) {	
-			if (match_results.contains(std::make_tuple(match_position+(piece_size*i), i, reference_id))) {
-				matched_pieces++;
-			}
-		}
-
-		if (matched_pieces == pieces.size()-1) {
-			if (!quiet)
-				seqan3::debug_stream <<  query << "," << match_position-(piece_size*piece_id) << "\n";
-		} else if (matched_pieces == pieces.size()-2) {
-			//seqan3::debug_stream << "Verifying partial match\n";
-			if (verify(reference[reference_id], query, (match_position-((piece_size*piece_id)+first_offset)), number_of_errors)) {
-				if (!quiet)
-					seqan3::debug_stream << query << "," << (match_position-((piece_size*piece_id)+first_offset)) << "\n";
-			}
-		}
-	}
-
-	if (read_num % 10 == 0) {
-		benchmark.write(read_num);
-	}
-	read_num++;
-
+    QueryDedup const* fan_out = use_dedup ? &dedup : nullptr;
+    if (!stream) {
+        load_benchmark.phase("load_queries");
     }
 
+    auto writer = ResultWriter{output_file, parse_result_format(format_name, quiet), options.locate.count_only};
+    auto const format = writer.get_format();
+
+    // loading fm-index into memory, pieces are searched without errors so a
+    // bidirectional index works just as well as a unidirectional one
+    visit_index(index_path, [&]<typename index_t>(index_t const& index, IndexExtras const& extras) {
+        load_benchmark.phase("load_index");
+        auto method = std::string{is_native_index<index_t> ? "native_fmindex_pigeon" : "fmindex_pigeon"};
+        if (partition == "adaptive") {
+            method += "_adaptive";
+        }
+        if (extra_piece) {
+            method += "_extra_piece";
+        }
+        if (error_model == "edit") {
+            method += "_edit";
+        }
+        if (both) {
+            method += "_both_strands";
+        }
+        if (use_dedup) {
+            method += "_dedup";
+        }
+        method += options.locate.method_suffix();
+        auto benchmark = Benchmark(stream ? method + "_stream" : method, reference_file.empty() ? index_path : reference_file, query_file, number_of_errors);
+
+        // the pieces of a batch of reads are searched on the calling thread,
+        // the batches themselves are distributed by parallel_chunks
+        auto const pigeon = PigeonOptions{
+            .errors      = number_of_errors,
+            .edit        = error_model == "edit",
+            .adaptive    = partition == "adaptive",
+            .extra_piece = extra_piece,
+            .both        = both,
+        };
+
+        // one arena per thread of parallel_chunks
+        auto arenas = std::vector<PigeonArena>(options.threads);
+
+        // searches a batch of reads and formats their hits, or counts, into `out`
+        auto search_reads = [&](auto const& batch, size_t first_id, PigeonArena& arena, std::string& out) {
+            pigeon_search(index, extras, reference, batch, first_id, pigeon, options, arena, [&](Hit const& hit) {
+                for_each_original(fan_out, hit.query_id, [&](size_t id) {
+                    auto copy = hit;
+                    copy.query_id = id;
+                    append_hit(out, format, copy);
+                });
+            }, [&](size_t query_id, size_t count) {
+                for_each_original(fan_out, query_id, [&](size_t id) {
+                    append_count(out, format, id, count);
+                });
+            });
+        };
+
+        auto output_mutex = std::mutex{};
+        int read_num = 0;
+        auto count_reads = [&](size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                if (read_num % 10 == 0) {
+                    benchmark.write(read_num);
+                }
+                read_num++;
+            }
+        };
+
+        // piece hits and verifications per read, to compare partitionings
+        auto write_stats = [&] {
+            size_t candidates    = 0;
+            size_t verifications = 0;
+            for (auto const& arena : arenas) {
+                candidates    += arena.candidate_count;
+                verifications += arena.verification_count;
+            }
+            auto const reads = static_cast<double>(std::max(read_num, 1));
+            benchmark.write_stat("candidates_per_read", candidates / reads);
+            benchmark.write_stat("verifications_per_read", verifications / reads);
+            if (use_dedup) {
+                benchmark.write_stat("cache_hit_rate", dedup.hit_rate());
+            }
+        };
+
+        if (stream) {
+            // parse, search and print batches of queries concurrently, see query_pipeline.hpp
+            run_query_pipeline(query_file, number_of_queries, [&](QueryBatch const& batch, std::string& out) {
+                parallel_chunks(batch.queries.size(), batch_size, options.threads, [&](size_t thread_id, size_t begin, size_t end) {
+                    auto chunk_out = std::string{};
+                    auto const start = std::chrono::steady_clock::now();
+                    search_reads(std::span{batch.queries}.subspan(begin, end - begin), batch.first_id + begin, arenas[thread_id], chunk_out);
+                    benchmark.record_chunk(std::chrono::steady_clock::now() - start, end - begin);
+                    std::lock_guard lock{output_mutex};
+                    out += chunk_out;
+                });
+            }, [&](OutputBatch const& batch) {
+                writer.write(batch.text);
+                count_reads(batch.query_count);
+            });
+            writer.flush();
+            benchmark.phase("search"); // includes the output, which overlaps with it
+            write_stats();
+            return;
+        }
+
+        auto const searched = use_dedup ? dedup.unique : std::vector<std::span<seqan3::dna5 const>>(queries.begin(), queries.end());
+        parallel_chunks(searched.size(), batch_size, options.threads, [&](size_t thread_id, size_t begin, size_t end) {
+            auto out = std::string{};
+            auto const start = std::chrono::steady_clock::now();
+            search_reads(std::span{searched}.subspan(begin, end - begin), begin, arenas[thread_id], out);
+            benchmark.record_chunk(std::chrono::steady_clock::now() - start, end - begin);
+            writer.write(out);
+
+            std::lock_guard lock{output_mutex};
+            count_reads(end - begin);
+        });
+        benchmark.phase("search");
+        writer.flush();
+        benchmark.phase("output");
+        write_stats();
+    });
 
     return 0;
 }
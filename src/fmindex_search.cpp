@@ -1,6 +1,17 @@
 #include "benchmark.hpp"
+#include "fm_search.hpp"
+#include "index_file.hpp"
+#include "query_dedup.hpp"
+#include "query_pipeline.hpp"
+#include "result_sink.hpp"
+#include "sharded_index.hpp"
+#include "strands.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <span>
 #include <sstream>
+#include <utility>
 
 #include <seqan3/alphabet/nucleotide/dna5.hpp>
 #include <seqan3/argument_parser/all.hpp>
@@ -9,6 +20,34 @@
 #include <seqan3/search/fm_index/fm_index.hpp>
 #include <seqan3/search/search.hpp>
 
+// prints the hit rate of the k-mer table on a sample of the queries and
+// measures the time it saves per query by repeating the interval computation
+// of the sample with and without it; the search itself counts nothing
+template <typename index_t>
+void report_kmer_table(index_t const& index, KmerTable const& kmer_table, std::vector<std::vector<seqan3::dna5>> const& queries) {
+    auto const sample = std::span{queries}.first(std::min<size_t>(queries.size(), 100'000));
+    auto const hits   = std::ranges::count_if(sample, [&](auto const& query) { return kmer_table.kmer_code(query).has_value(); });
+    seqan3::debug_stream << "k-mer table (k=" << int{kmer_table.k} << "): " << hits << " of " << sample.size() << " lookups hit ("
+                         << (sample.empty() ? 0.0 : 100.0 * hits / sample.size()) << "%)\n";
+
+    auto measure = [&](auto&& search) {
+        size_t checksum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (auto const& query : sample) {
+            checksum += search(query).len;
+        }
+        auto ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        return std::make_pair(ns / std::max<size_t>(sample.size(), 1), checksum);
+    };
+    auto [with_table, checksum_with]       = measure([&](auto const& query) { return kmer_table.backward_search(index, query); });
+    auto [without_table, checksum_without] = measure([&](auto const& query) { return backward_search(index, query); });
+    if (checksum_with != checksum_without) {
+        seqan3::debug_stream << "k-mer table intervals differ from the plain backward search\n";
+    }
+    seqan3::debug_stream << "k-mer table saves " << without_table - with_table << "ns per query ("
+                         << without_table << "ns without, " << with_table << "ns with table)\n";
+}
+
 int main(int argc, char const* const* argv) {
     seqan3::argument_parser parser{"fmindex_search", argc, argv, seqan3::update_notifications::off};
 
@@ -30,47 +69,265 @@ int main(int argc, char const* const* argv) {
     auto quiet = false;
     parser.add_option(quiet, '\0', "quiet", "do not print matches");
 
+    auto options = SearchOptions{};
+    parser.add_option(options.interleave, '\0', "interleave", "number of exact searches on a native index that are advanced together with prefetching, needs an occurrence table that can prefetch",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1024});
+    parser.add_flag(options.trie, '\0', "trie", "search the queries of a chunk as a trie over their reversed sequences on a native unidirectional index, shared suffixes are extended once");
+    parser.add_option(options.threads, '\0', "threads", "number of threads used for searching",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1024});
+
+    auto output_file = std::filesystem::path{"-"};
+    parser.add_option(output_file, '\0', "output", "file the matches are written to, - for stdout");
+
+    auto format_name = std::string{"sam"};
+    parser.add_option(format_name, '\0', "format", "output format of the matches, sam or binary",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{result_format_names});
+
+    parser.add_flag(options.locate.count_only, '\0', "count-only", "only report the number of occurrences per query, nothing is located");
+    parser.add_option(options.locate.max_hits, '\0', "max-hits", "locate at most this many occurrences per query, 0 locates all");
+
+    auto both = false;
+    parser.add_flag(both, '\0', "both-strands", "also search the reverse complement of every query in the same batch, --max-hits applies to each strand");
+
+    auto stream = false;
+    parser.add_flag(stream, '\0', "stream", "search while reading the queries instead of loading all of them first");
+
+    auto use_dedup = false;
+    parser.add_flag(use_dedup, '\0', "dedup", "search every distinct query once and report its results for all queries with the same sequence (not with --stream)");
+
+    auto latency = false;
+    parser.add_flag(latency, '\0', "latency", "record latency percentiles, per query for native indices searched one query at a time, per chunk of queries otherwise");
+
+    auto parallel_shards = size_t{1};
+    parser.add_option(parallel_shards, '\0', "parallel-shards", "number of shards of a sharded index that are loaded and searched at the same time",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1024});
+
     try {
          parser.parse();
     } catch (seqan3::argument_parser_error const& ext) {
         seqan3::debug_stream << "Parsing error. " << ext.what() << "\n";
         return EXIT_FAILURE;
     }
+    auto const sharded = is_sharded_index(index_path);
+    if (sharded && stream) {
+        // every batch would need every shard, which defeats loading only a few at a time
+        seqan3::debug_stream << "--stream does not support sharded indices\n";
+        return EXIT_FAILURE;
+    }
+    if (use_dedup && stream) {
+        seqan3::debug_stream << "--dedup needs all queries in memory and does not support --stream\n";
+        return EXIT_FAILURE;
+    }
+    if (options.interleave > 1) {
+        // the interleaved search hides the occ lookups behind prefetches, see batched_search.hpp
+        auto manifest = sharded ? read_manifest(index_path) : ShardManifest{};
+        auto const header = read_index_header(manifest.shards.empty() ? index_path : shard_path(index_path, manifest.shards.front()));
+        if (header.backend == IndexBackend::native && !occ_table_can_prefetch(header.occ_table)) {
+            seqan3::debug_stream << "--interleave needs an occurrence table that can prefetch, " << header.occ_table << " cannot\n";
+            return EXIT_FAILURE;
+        }
+    }
 
-    // loading our files
-    auto query_stream     = seqan3::sequence_file_input{query_file};
-
-    // read query into memory
+    // read query into memory, unless they are streamed during the search; the
+    // phases of the run are written to cpp_benchmark_phases.csv
+    auto queries_benchmark = Benchmark("fmindex_queries", "", query_file, 0);
     std::vector<std::vector<seqan3::dna5>> queries;
-    for (auto& record : query_stream) {
-        queries.push_back(record.sequence());
+    if (!stream) {
+        auto query_stream = seqan3::sequence_file_input{query_file};
+        for (auto& record : query_stream) {
+            queries.push_back(record.sequence());
+        }
+
+        // duplicate input until its large enough
+        while (queries.size() < number_of_queries) {
+            auto old_count = queries.size();
+            queries.resize(2 * old_count);
+            std::copy_n(queries.begin(), old_count, queries.begin() + old_count);
+        }
+        queries.resize(number_of_queries); // will reduce the amount of searches
     }
 
-    // loading fm-index into memory
-    using Index = decltype(seqan3::fm_index{std::vector<std::vector<seqan3::dna5>>{}}); // Some hack
-    Index index; // construct fm-index
-    {
-        seqan3::debug_stream << "Loading 2FM-Index ... " << std::flush;
-        std::ifstream is{index_path, std::ios::binary};
-        cereal::BinaryInputArchive iarchive{is};
-        iarchive(index);
-        seqan3::debug_stream << "done\n";
+    // with --dedup only the distinct queries are searched, their results are
+    // reported for all of their copies, see query_dedup.hpp
+    auto dedup = QueryDedup{};
+    if (use_dedup) {
+        dedup = dedup_queries(queries);
+    }
+    if (!stream) {
+        queries_benchmark.phase("load_queries");
     }
+    QueryDedup const* fan_out = use_dedup ? &dedup : nullptr;
+    auto with_queries = [&](auto&& search) {
+        if (use_dedup) {
+            search(dedup.unique);
+        } else {
+            search(queries);
+        }
+    };
+    auto const dedup_suffix = std::string{use_dedup ? "_dedup" : ""};
+
+    auto writer = ResultWriter{output_file, parse_result_format(format_name, quiet), options.locate.count_only};
+    auto const format = writer.get_format();
 
-    // duplicate input until its large enough
-    while (queries.size() < number_of_queries) {
-        auto old_count = queries.size();
-        queries.resize(2 * old_count);
-        std::copy_n(queries.begin(), old_count, queries.begin() + old_count);
+    // formats a hit, or the count, of a searched query for every query it stands for
+    auto append_hits = [&](std::string& out, Hit hit) {
+        for_each_original(fan_out, hit.query_id, [&](size_t id) {
+            hit.query_id = id;
+            append_hit(out, format, hit);
+        });
+    };
+    auto append_counts = [&](std::string& out, size_t query_id, size_t count) {
+        for_each_original(fan_out, query_id, [&](size_t id) {
+            append_count(out, format, id, count);
+        });
+    };
+
+    // With --both-strands query i is searched as query 2i and its reverse
+    // complement as query 2i + 1 of the same batch, see strands.hpp. Counts of
+    // both strands are added up, they are reported in order of the query ids.
+    size_t const strand_count = both ? 2 : 1;
+    auto const strand_suffix  = std::string{both ? "_both_strands" : ""};
+    auto with_strands = [&](auto const& queries, auto&& search) {
+        if (both) {
+            auto reverse = std::vector<std::vector<seqan3::dna5>>{};
+            search(both_strands(queries, reverse));
+        } else {
+            search(queries);
+        }
+    };
+    // with --latency the searches time their queries or chunks, the
+    // latencies go to the stats of `benchmark`
+    auto timed_options = [&](Benchmark& benchmark) {
+        auto timed = options;
+        if (latency) {
+            timed.query_timer = [&benchmark](std::chrono::nanoseconds duration) {
+                benchmark.record_query(duration);
+            };
+            timed.chunk_timer = [&benchmark](std::chrono::nanoseconds duration, size_t query_count) {
+                benchmark.record_chunk(duration, query_count);
+            };
+        }
+        return timed;
+    };
+    auto strand_hit = [&](size_t first_id, size_t query_id, size_t reference_id, size_t position) {
+        if (!both) return Hit{first_id + query_id, reference_id, position};
+        return Hit{first_id + strand_query_id(query_id), reference_id, position, Hit::unknown_errors, is_reverse_strand(query_id)};
+    };
+
+    if (sharded) {
+        // the shards are loaded and searched one after another, up to
+        // --parallel-shards at a time, hits are reported shard by shard
+        auto manifest  = read_manifest(index_path);
+        auto benchmark = Benchmark("sharded_fm_index" + strand_suffix + dedup_suffix + options.locate.method_suffix(), index_path, query_file, number_of_errors);
+        auto const timed = timed_options(benchmark);
+        auto out = std::string{};
+        with_queries([&](auto const& queries) {
+            with_strands(queries, [&](auto const& searched) {
+                if (options.locate.count_only) {
+                    size_t pending = 0;
+                    sharded_count(index_path, manifest, parallel_shards, searched, number_of_errors, [&](size_t query_id, size_t count) {
+                        pending += count;
+                        if (query_id % strand_count == strand_count - 1) {
+                            append_counts(out, query_id / strand_count, std::exchange(pending, 0));
+                        }
+                    }, timed);
+                    return;
+                }
+                sharded_search(index_path, manifest, parallel_shards, searched, number_of_errors, [&](size_t query_id, size_t reference_id, size_t position) {
+                    append_hits(out, strand_hit(0, query_id, reference_id, position));
+                    if (out.size() >= ResultWriter::buffer_size / 4) {
+                        writer.write(out);
+                        out.clear();
+                    }
+                }, timed);
+            });
+        });
+        writer.write(out);
+        benchmark.write(queries.size());
+        benchmark.phase("search"); // includes loading the shards
+        writer.flush();
+        benchmark.phase("output");
+        if (use_dedup) {
+            benchmark.write_stat("cache_hit_rate", dedup.hit_rate());
+        }
+        return 0;
     }
-    queries.resize(number_of_queries); // will reduce the amount of searches
-
-    seqan3::configuration const cfg = seqan3::search_cfg::max_error_total{seqan3::search_cfg::error_count{number_of_errors}};
-    auto benchmark = Benchmark("fm_index", index_path, query_file, number_of_errors);
-    auto results = seqan3::search(queries, index, cfg);
-    for (auto && result : results)
-	    if (!quiet)
-	    	seqan3::debug_stream << result << "\n";
-    benchmark.write(queries.size());
+
+    // loading fm-index into memory, an index built with --bidirectional is a
+    // bi_fm_index for which seqan3::search uses optimum search schemes instead
+    // of unidirectional backtracking when errors are allowed
+    auto load_benchmark = Benchmark("fmindex_load", index_path, "", 0);
+    visit_index(index_path, [&]<typename index_t>(index_t const& index, IndexExtras const& extras) {
+        load_benchmark.write(0);
+        load_benchmark.phase("load_index");
+        auto method = std::string{is_native_index<index_t> ? "native_" : ""};
+        method += std::same_as<index_t, BiIndex> || is_native_bi_index<index_t> ? "bi_fm_index" : "fm_index";
+        if (options.trie && is_native_index<index_t> && !is_native_bi_index<index_t>) {
+            method += "_trie";
+        }
+        method += strand_suffix + dedup_suffix + options.locate.method_suffix();
+
+        // formats the hits, or only the counts, of `queries` into `out`; with
+        // `flush_full` a full buffer is handed to the writer right away
+        auto search_queries = [&](auto const& queries, size_t first_id, std::string& out, bool flush_full, SearchOptions const& search_options) {
+            with_strands(queries, [&](auto const& searched) {
+                if (search_options.locate.count_only) {
+                    size_t pending = 0;
+                    fm_count(index, searched, number_of_errors, [&](size_t query_id, size_t count) {
+                        pending += count;
+                        if (query_id % strand_count == strand_count - 1) {
+                            append_counts(out, first_id + query_id / strand_count, std::exchange(pending, 0));
+                        }
+                    }, extras, search_options);
+                    return;
+                }
+                fm_search(index, searched, number_of_errors, [&](size_t query_id, size_t reference_id, size_t position) {
+                    append_hits(out, strand_hit(first_id, query_id, reference_id, position));
+                    if (flush_full && out.size() >= ResultWriter::buffer_size / 4) {
+                        writer.write(out);
+                        out.clear();
+                    }
+                }, extras, search_options);
+            });
+        };
+
+        if (stream) {
+            // parse, search and print batches of queries concurrently, see query_pipeline.hpp
+            auto benchmark = Benchmark(method + "_stream", index_path, query_file, number_of_errors);
+            auto const timed = timed_options(benchmark);
+            size_t read_num = 0;
+            run_query_pipeline(query_file, number_of_queries, [&](QueryBatch const& batch, std::string& out) {
+                search_queries(batch.queries, batch.first_id, out, /*flush_full=*/false, timed);
+            }, [&](OutputBatch const& batch) {
+                writer.write(batch.text);
+                read_num += batch.query_count;
+            });
+            benchmark.write(read_num);
+            writer.flush();
+            benchmark.phase("search"); // includes the output, which overlaps with it
+            return;
+        }
+
+        auto benchmark = Benchmark(method, index_path, query_file, number_of_errors);
+        auto const timed = timed_options(benchmark);
+        auto out = std::string{};
+        with_queries([&](auto const& queries) {
+            search_queries(queries, 0, out, /*flush_full=*/true, timed);
+        });
+        writer.write(out);
+        benchmark.write(queries.size());
+        benchmark.phase("search");
+        writer.flush();
+        benchmark.phase("output");
+        if (use_dedup) {
+            benchmark.write_stat("cache_hit_rate", dedup.hit_rate());
+        }
+
+        if constexpr (is_native_index<index_t> && !is_native_bi_index<index_t>) {
+            if (!extras.kmer_table.empty() && number_of_errors == 0) {
+                report_kmer_table(index, extras.kmer_table, queries);
+            }
+        }
+    });
     return 0;
 }
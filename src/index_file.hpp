@@ -0,0 +1,163 @@
+#ifndef INDEX_FILE_HPP
+#define INDEX_FILE_HPP
+
+#include "fm_native.hpp"
+#include "kmer_table.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+#include <seqan3/core/debug_stream.hpp>
+#include <seqan3/search/fm_index/bi_fm_index.hpp>
+#include <seqan3/search/fm_index/fm_index.hpp>
+
+using Index   = decltype(seqan3::fm_index{std::vector<std::vector<seqan3::dna5>>{}}); // Some hack
+using BiIndex = decltype(seqan3::bi_fm_index{std::vector<std::vector<seqan3::dna5>>{}});
+
+// which library provides the fm-index stored in a file
+enum class IndexBackend : uint8_t {
+    seqan3,
+    native, // fmindex-collection, see fm_native.hpp
+};
+
+// Every index written by fmindex_construct starts with a magic number followed
+// by this header. Files without the magic number are treated as plain
+// (unidirectional) seqan3::fm_index archives written by older versions.
+struct IndexHeader {
+    static constexpr uint64_t magic           = 0x5844'4e49'4d46'5349; // "ISFMINDX"
+    static constexpr uint32_t current_version = 6;
+
+    uint32_t     version       = current_version;
+    bool         bidirectional = false;
+    IndexBackend backend       = IndexBackend::seqan3;
+    std::string  occ_table;    // only used by the native backend
+    uint8_t      kmer_length   = 0; // a KmerTable follows the index if not 0
+    uint32_t     sa_sampling   = 16; // every sa_sampling-th suffix array entry is stored
+    uint64_t     reference_count  = 0; // number of reference sequences in the index
+    uint64_t     reference_length = 0; // total number of bases
+    bool         stored_text      = false; // the packed references follow, see reference_text.hpp
+
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        ar(version, bidirectional);
+        if (version >= 2) {
+            ar(backend, occ_table);
+        }
+        if (version >= 3) {
+            ar(kmer_length);
+        }
+        if (version >= 4) {
+            ar(sa_sampling);
+        }
+        if (version >= 5) {
+            ar(reference_count, reference_length);
+        }
+        if (version >= 6) {
+            ar(stored_text);
+        }
+    }
+};
+
+// first bytes of the manifest of a sharded index, see sharded_index.hpp
+inline constexpr uint64_t shard_manifest_magic = 0x4452'4853'4d46'5349; // "ISFMSHRD"
+
+// everything stored next to the index itself
+struct IndexExtras {
+    IndexHeader header;
+    KmerTable   kmer_table;
+};
+
+// writes magic number and header, the index itself has to follow in the same archive
+inline void write_index_header(std::ostream& os, cereal::BinaryOutputArchive& oarchive, IndexHeader const& header) {
+    os.write(reinterpret_cast<char const*>(&IndexHeader::magic), sizeof(IndexHeader::magic));
+    oarchive(header);
+}
+
+// reads the header if present, otherwise rewinds and reports a legacy index
+inline IndexHeader read_index_header(std::istream& is) {
+    auto magic = uint64_t{};
+    is.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    if (is && magic == shard_manifest_magic) {
+        throw std::runtime_error{"index file is a sharded index, which only fmindex_search supports"};
+    }
+    if (!is || magic != IndexHeader::magic) {
+        is.clear();
+        is.seekg(0);
+        return IndexHeader{.version = 0};
+    }
+    auto header = IndexHeader{};
+    cereal::BinaryInputArchive iarchive{is};
+    iarchive(header);
+    if (header.version > IndexHeader::current_version) {
+        throw std::runtime_error{"index file was written by a newer version of fmindex_construct"};
+    }
+    return header;
+}
+
+// reads only the header of the index stored at `index_path`
+inline IndexHeader read_index_header(std::filesystem::path const& index_path) {
+    std::ifstream is{index_path, std::ios::binary};
+    if (!is) {
+        throw std::runtime_error{"could not open index file " + index_path.string()};
+    }
+    return read_index_header(is);
+}
+
+// loads the index stored at `index_path` and calls `f(index, extras)` with it,
+// the type of the index (seqan3 or native, unidirectional or bidirectional,
+// occurrence table) depends on the header of the file
+template <typename F>
+void visit_index(std::filesystem::path const& index_path, F&& f) {
+    std::ifstream is{index_path, std::ios::binary};
+    if (!is) {
+        throw std::runtime_error{"could not open index file " + index_path.string()};
+    }
+    auto extras = IndexExtras{};
+    extras.header = read_index_header(is);
+    auto const& header = extras.header;
+
+    auto load = [&]<typename index_t>(index_t& index) {
+        seqan3::debug_stream << "Loading 2FM-Index ... " << std::flush;
+        cereal::BinaryInputArchive iarchive{is};
+        iarchive(index);
+        if (header.kmer_length > 0) {
+            iarchive(extras.kmer_table);
+        }
+        seqan3::debug_stream << "done\n";
+    };
+
+    if (header.backend == IndexBackend::native) {
+        auto known = visit_occ_table(header.occ_table, [&]<typename occ_t>(std::type_identity<occ_t>) {
+            if (header.bidirectional) {
+                auto index = NativeBiIndex<occ_t>{fmindex_collection::cereal_tag{}};
+                load(index);
+                f(index, std::as_const(extras));
+            } else {
+                auto index = NativeIndex<occ_t>{fmindex_collection::cereal_tag{}};
+                load(index);
+                f(index, std::as_const(extras));
+            }
+        });
+        if (!known) {
+            throw std::runtime_error{"index file uses unknown occurrence table " + header.occ_table};
+        }
+    } else if (header.bidirectional) {
+        BiIndex index;
+        load(index);
+        f(index, std::as_const(extras));
+    } else {
+        Index index;
+        load(index);
+        f(index, std::as_const(extras));
+    }
+}
+
+#endif
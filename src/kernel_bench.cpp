@@ -0,0 +1,470 @@
+#include "banded_alignment.hpp"
+#include "fm_native.hpp"
+#include "index_file.hpp"
+#include "naive_search.hpp"
+#include "packed_sequence.hpp"
+#include "pigeon_candidates.hpp"
+#include "query_trie.hpp"
+#include "reference_text.hpp"
+#include "result_sink.hpp"
+#include "suffixarray_search.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <fmindex-collection/fmindex-collection.h>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+#include <seqan3/argument_parser/all.hpp>
+#include <seqan3/core/debug_stream.hpp>
+
+// keeps the compiler from dropping the computation of `value`
+template <typename T>
+void keep(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// inputs of all kernels, generated from a fixed seed
+struct KernelInputs {
+    std::vector<seqan3::dna5>              reference;
+    std::vector<std::vector<seqan3::dna5>> reads;     // with up to `errors` substitutions
+    std::vector<size_t>                    positions; // where each read was taken from
+};
+
+// A reference of `length` bases built from blocks of 1000: with probability
+// `repeat` a block is a copy of an earlier one with 1% substitutions,
+// otherwise it is random. Reads are taken from uniform positions.
+KernelInputs make_inputs(size_t length, double repeat, size_t read_count, size_t read_length, uint8_t errors, uint64_t seed) {
+    auto rng  = std::mt19937_64{seed};
+    auto base = [&] { return seqan3::dna5{}.assign_rank(std::array{0, 1, 2, 4}[rng() % 4]); };
+    auto coin = std::bernoulli_distribution{repeat};
+
+    auto inputs = KernelInputs{};
+    constexpr size_t block = 1000;
+    inputs.reference.reserve(length);
+    while (inputs.reference.size() < length) {
+        auto const blocks = inputs.reference.size() / block;
+        auto const size   = std::min(block, length - inputs.reference.size());
+        if (blocks > 0 && coin(rng)) {
+            auto const from = rng() % blocks * block;
+            for (size_t i = 0; i < size; ++i) {
+                inputs.reference.push_back(rng() % 100 == 0 ? base() : inputs.reference[from + i]);
+            }
+        } else {
+            for (size_t i = 0; i < size; ++i) {
+                inputs.reference.push_back(base());
+            }
+        }
+    }
+
+    read_length = std::min(read_length, length);
+    for (size_t r = 0; r < read_count; ++r) {
+        auto const position = rng() % (length - read_length + 1);
+        auto& read = inputs.reads.emplace_back(inputs.reference.begin() + position, inputs.reference.begin() + position + read_length);
+        for (uint8_t e = 0; e < errors && read_length > 0; ++e) {
+            read[rng() % read_length] = base();
+        }
+        inputs.positions.push_back(position);
+    }
+    return inputs;
+}
+
+// median and minimum time of one operation of a kernel
+struct KernelResult {
+    std::string name;
+    size_t      ops;       // per call of the kernel
+    double      median_ns; // per operation
+    double      min_ns;
+};
+
+// Compares the bit-level kernels against plain implementations on small
+// random inputs with many Ns, short sequences and positions at the ends of the
+// reference, prints every kernel that disagrees and returns how many do.
+size_t verify_kernels(uint64_t seed, std::string const& occ_table) {
+    auto rng = std::mt19937_64{seed};
+    // ACGT, every other sequence has single Ns and N runs, some of them at its ends
+    auto sequence = [&](size_t length) {
+        auto result = std::vector<seqan3::dna5>(length);
+        for (auto& b : result) {
+            b.assign_rank(std::array{0, 1, 2, 4}[rng() % 4]);
+        }
+        if (length > 0 && rng() % 2 == 0) {
+            for (size_t n = rng() % 4; n > 0; --n) {
+                auto const begin = rng() % 3 == 0 ? (rng() % 2 ? 0 : length - 1) : rng() % length;
+                auto const end   = std::min(length, begin + 1 + (rng() % 2 ? 0 : rng() % 40));
+                std::fill(result.begin() + begin, result.begin() + end, seqan3::dna5{}.assign_rank(3));
+            }
+        }
+        return result;
+    };
+    size_t failed = 0;
+    auto check = [&](std::string const& kernel, size_t mismatches) {
+        if (mismatches > 0) {
+            seqan3::debug_stream << kernel << ": " << mismatches << " results differ from the plain implementation\n";
+            ++failed;
+        }
+    };
+
+    // packed_hamming, including the correction for Ns packed as A
+    size_t hamming_mismatches = 0;
+    for (size_t round = 0; round < 2000; ++round) {
+        auto const reference = sequence(1 + rng() % 200);
+        auto const read      = sequence(1 + rng() % reference.size());
+        auto const begin     = rng() % (reference.size() - read.size() + 1);
+        int expected = 0;
+        for (size_t i = 0; i < read.size(); ++i) {
+            expected += reference[begin + i] != read[i];
+        }
+        auto const packed_reference = PackedSequence{reference};
+        auto const packed_read      = PackedSequence{read};
+        for (int max_errors = 0; max_errors <= 5; ++max_errors) {
+            auto const mismatches = packed_hamming(packed_reference.view(), packed_read.view(), begin, max_errors);
+            hamming_mismatches += expected <= max_errors ? mismatches != expected : mismatches <= max_errors;
+        }
+    }
+    check("packed_hamming", hamming_mismatches);
+
+    // the ISTEXT01 section behind an index of any length, read back through MappedFile
+    size_t text_mismatches = 0;
+    auto const text_path = std::filesystem::temp_directory_path() / "kernel_bench.text";
+    for (size_t round = 0; round < 50; ++round) {
+        auto references = std::vector<std::vector<seqan3::dna5>>(rng() % 5);
+        for (auto& reference : references) {
+            reference = sequence(rng() % 4 == 0 ? 32 * (rng() % 4) : rng() % 300);
+        }
+        {
+            std::ofstream os{text_path, std::ios::binary};
+            for (size_t i = rng() % 16; i > 0; --i) {
+                os.put('x'); // the index the text is appended to
+            }
+            write_reference_text(os, references);
+        }
+        auto const text = ReferenceText::from_index(text_path);
+        text_mismatches += text.size() != references.size();
+        for (size_t r = 0; r < std::min(text.size(), references.size()); ++r) {
+            auto const& view = text[r];
+            text_mismatches += view.length != references[r].size();
+            for (size_t i = 0; i < std::min(view.length, references[r].size()); ++i) {
+                constexpr uint8_t ranks[] = {0, 1, 2, 4}; // dna5 rank of a 2-bit code
+                auto const rank = view.is_n(i) ? 3 : ranks[view.code(i)];
+                text_mismatches += rank != references[r][i].to_rank();
+            }
+        }
+    }
+    std::filesystem::remove(text_path);
+    check("reference_text", text_mismatches);
+
+    // banded_edit_distance against the full dynamic programming matrix,
+    // restricted to the same band, with diagonals at both ends of the reference
+    size_t edit_mismatches = 0;
+    for (size_t round = 0; round < 2000; ++round) {
+        auto const reference = sequence(1 + rng() % 60);
+        auto const read      = sequence(1 + rng() % 30);
+        int const  k         = static_cast<int>(rng() % 7); // the fixed bands and the general one
+        auto const diagonal  = rng() % (reference.size() + 2 * k + 1);
+        if (diagonal > reference.size() + k) continue; // no cell of the band starts inside the reference
+
+        // cost of the best alignment that starts at reference position
+        // `start`, or of any start in the band if there is none; cell (i, j)
+        // has read i bases and ends before reference position j
+        constexpr int infinity = 1 << 24;
+        auto const n = read.size();
+        auto const m = reference.size();
+        auto in_band = [&](size_t i, size_t j) {
+            auto const offset = static_cast<int64_t>(j) - static_cast<int64_t>(i) - (static_cast<int64_t>(diagonal) - k);
+            return offset >= 0 && offset <= 2 * k;
+        };
+        auto best_cost = [&](std::optional<size_t> start) {
+            auto cost = std::vector<std::vector<int>>(n + 1, std::vector<int>(m + 1, infinity));
+            for (size_t j = 0; j <= m; ++j) {
+                if (in_band(0, j) && (!start || j == *start)) cost[0][j] = 0;
+            }
+            for (size_t i = 0; i <= n; ++i) {
+                for (size_t j = 0; j <= m; ++j) {
+                    if (!in_band(i, j)) continue;
+                    if (i > 0 && j > 0 && in_band(i - 1, j - 1)) cost[i][j] = std::min(cost[i][j], cost[i - 1][j - 1] + int{reference[j - 1] != read[i - 1]});
+                    if (i > 0 && in_band(i - 1, j))              cost[i][j] = std::min(cost[i][j], cost[i - 1][j] + 1);
+                    if (j > 0 && in_band(i, j - 1))              cost[i][j] = std::min(cost[i][j], cost[i][j - 1] + 1);
+                }
+            }
+            return *std::ranges::min_element(cost[n]);
+        };
+        auto const expected  = best_cost(std::nullopt);
+        auto const alignment = banded_edit_distance(PackedSequence{reference}.view(), read, diagonal, k);
+        if (expected > k) {
+            edit_mismatches += alignment.errors <= k;
+        } else {
+            // any begin of an alignment with the fewest errors is correct
+            edit_mismatches += alignment.errors != expected || best_cost(alignment.begin) != expected;
+        }
+    }
+    check("banded_edit_distance", edit_mismatches);
+
+    // trie_search against a backtracking search per query, on queries that
+    // share prefixes and suffixes or are duplicates of each other
+    size_t trie_mismatches = 0;
+    visit_occ_table(occ_table, [&]<typename occ_t>(std::type_identity<occ_t>) {
+        for (size_t round = 0; round < 20; ++round) {
+            auto const reference = sequence(200 + rng() % 200);
+            auto const index     = NativeIndex<occ_t>{to_native_text({reference}), /*samplingRate=*/16, /*threadNbr=*/1};
+            auto queries = std::vector<std::vector<seqan3::dna5>>{};
+            for (size_t q = 0; q < 40; ++q) {
+                if (!queries.empty() && rng() % 3 == 0) {
+                    // a copy of an earlier query, possibly cut at either end
+                    auto query = queries[rng() % queries.size()];
+                    if (rng() % 2 && query.size() > 1) query.erase(query.begin());
+                    if (rng() % 2 && query.size() > 1) query.pop_back();
+                    queries.push_back(std::move(query));
+                } else {
+                    auto const length = 1 + rng() % 12;
+                    auto const begin  = rng() % (reference.size() - length + 1);
+                    queries.emplace_back(reference.begin() + begin, reference.begin() + begin + length);
+                }
+            }
+            auto trie = QueryTrie{};
+            trie.build(queries);
+            for (uint8_t max_errors = 0; max_errors <= 2; ++max_errors) {
+                auto found = std::vector<std::tuple<size_t, size_t, size_t>>{};
+                trie_search(index, trie, max_errors, [&](size_t query_id, NativeInterval iv) {
+                    found.emplace_back(query_id, iv.lb, iv.len);
+                });
+                auto expected = std::vector<std::tuple<size_t, size_t, size_t>>{};
+                for (size_t query_id = 0; query_id < queries.size(); ++query_id) {
+                    backtrack_hamming(index, queries[query_id], max_errors, [&](NativeInterval iv, uint8_t) {
+                        expected.emplace_back(query_id, iv.lb, iv.len);
+                    });
+                }
+                std::ranges::sort(found);
+                std::ranges::sort(expected);
+                trie_mismatches += found != expected;
+            }
+        }
+    });
+    check("trie_search", trie_mismatches);
+
+    return failed;
+}
+
+int main(int argc, char const* const* argv) {
+    seqan3::argument_parser parser{"kernel_bench", argc, argv, seqan3::update_notifications::off};
+
+    parser.info.author = "SeqAn-Team";
+    parser.info.version = "1.0.0";
+    parser.info.short_description = "times the hot kernels of the searches on synthetic inputs of a fixed size and repetitiveness";
+
+    auto reference_length = size_t{1} << 22;
+    parser.add_option(reference_length, '\0', "reference-length", "number of bases of the synthetic reference",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{size_t{1000}, size_t{1} << 34});
+
+    auto repeat = 0.0;
+    parser.add_option(repeat, '\0', "repeat", "fraction of the reference made of copies of earlier parts",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{0.0, 1.0});
+
+    auto read_count = size_t{10'000};
+    parser.add_option(read_count, '\0', "reads", "number of synthetic reads",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 100'000'000});
+
+    auto read_length = size_t{100};
+    parser.add_option(read_length, '\0', "read-length", "length of the synthetic reads",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 100'000});
+
+    auto errors = uint8_t{2};
+    parser.add_option(errors, '\0', "errors", "substitutions per read and allowed errors of the verification kernels");
+
+    auto seed = uint64_t{42};
+    parser.add_option(seed, '\0', "seed", "seed of the synthetic inputs");
+
+    auto occ_table = std::string{"interleavedEPR16"};
+    parser.add_option(occ_table, '\0', "occ", "occurrence table of the native index",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{occ_table_names});
+
+    auto repetitions = size_t{5};
+    parser.add_option(repetitions, '\0', "repetitions", "timed runs of every kernel",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1000});
+
+    auto csv_file = std::filesystem::path{"kernel_bench.csv"};
+    parser.add_option(csv_file, '\0', "csv", "file the results are appended to");
+
+    auto verify = false;
+    parser.add_flag(verify, '\0', "verify", "compare packed_hamming, the stored reference text, banded_edit_distance and trie_search "
+                                            "against plain implementations on small random inputs instead of timing anything");
+
+    try {
+         parser.parse();
+    } catch (seqan3::argument_parser_error const& ext) {
+        seqan3::debug_stream << "Parsing error. " << ext.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    if (verify) {
+        auto const failed = verify_kernels(seed, occ_table);
+        seqan3::debug_stream << (failed ? "kernels differ from the plain implementations\n" : "all kernels agree with the plain implementations\n");
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    auto const inputs = make_inputs(reference_length, repeat, read_count, read_length, errors, seed);
+    auto const& reference = inputs.reference;
+    auto const  packed_reference = PackedSequence{reference};
+    auto const  reference_view   = packed_reference.view();
+
+    // Every kernel runs once untimed, then `repetitions` timed runs; `f` does
+    // `ops` operations per run.
+    auto results = std::vector<KernelResult>{};
+    auto measure = [&](std::string name, size_t ops, auto&& f) {
+        f();
+        auto times = std::vector<double>{};
+        for (size_t i = 0; i < repetitions; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            f();
+            times.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / std::max<size_t>(ops, 1));
+        }
+        std::ranges::sort(times);
+        auto const median = times.size() % 2 ? times[times.size() / 2] : (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2;
+        results.push_back({std::move(name), ops, median, times.front()});
+        seqan3::debug_stream << results.back().name << ": " << median << "ns per op\n";
+    };
+
+    // naive search, a full scan of the reference per read
+    auto const scanned = std::min<size_t>(read_count, 10);
+    measure("find_occurences", scanned, [&] {
+        size_t hits = 0;
+        for (size_t r = 0; r < scanned; ++r) {
+            findOccurences(reference, inputs.reads[r], [&](size_t) {
+                ++hits;
+                return true;
+            });
+        }
+        keep(hits);
+    });
+
+    // binary search on the suffix array
+    auto const suffixarray = fmindex_collection::createSA64(std::span{reinterpret_cast<uint8_t const*>(reference.data()), reference.size()}, 1);
+    measure("naive_binary_search", read_count, [&] {
+        size_t found = 0;
+        for (auto const& read : inputs.reads) {
+            auto const query = std::span<seqan3::dna5 const>{read};
+            found += std::get<0>(naive_binary_search(&query, &reference, &suffixarray)) >= 0;
+        }
+        keep(found);
+    });
+
+    // verification of pigeonhole candidates: the true position, then a random one
+    auto packed_reads = std::vector<PackedSequence>{};
+    for (auto const& read : inputs.reads) {
+        packed_reads.emplace_back(read);
+    }
+    auto verify_positions = std::vector<size_t>{};
+    auto rng = std::mt19937_64{seed + 1};
+    for (size_t r = 0; r < read_count; ++r) {
+        verify_positions.push_back(inputs.positions[r]);
+        verify_positions.push_back(rng() % (reference_length - inputs.reads[r].size() + 1));
+    }
+    measure("packed_hamming", 2 * read_count, [&] {
+        int mismatches = 0;
+        for (size_t i = 0; i < verify_positions.size(); ++i) {
+            mismatches += packed_hamming(reference_view, packed_reads[i / 2].view(), verify_positions[i], errors);
+        }
+        keep(mismatches);
+    });
+    measure("banded_edit_distance", 2 * read_count, [&] {
+        int edits = 0;
+        for (size_t i = 0; i < verify_positions.size(); ++i) {
+            edits += banded_edit_distance(reference_view, inputs.reads[i / 2], verify_positions[i], errors).errors;
+        }
+        keep(edits);
+    });
+
+    // candidate dedup: the votes of errors + 1 pieces per read, most of them
+    // for the true diagonal, and the alignments found from neighbouring ones
+    auto votes = std::vector<PigeonCandidate>{};
+    auto hits  = std::vector<PigeonAlignment>{};
+    for (size_t r = 0; r < read_count; ++r) {
+        for (size_t piece = 0; piece <= errors; ++piece) {
+            auto const diagonal = rng() % 4 == 0 ? rng() % reference_length : inputs.positions[r];
+            votes.push_back({r, 0, diagonal});
+        }
+        hits.push_back({{r, 0, inputs.positions[r], 0}, inputs.positions[r]});
+        hits.push_back({{r, 0, inputs.positions[r] + errors, 1}, inputs.positions[r] + 1});
+    }
+    std::ranges::shuffle(votes, rng);
+    auto candidates = std::vector<PigeonCandidate>{};
+    auto scratch    = std::vector<PigeonCandidate>{};
+    measure("radix_sort_candidates", votes.size(), [&] {
+        candidates = votes;
+        radix_sort(candidates, scratch);
+        size_t distinct = 0;
+        for_each_candidate(candidates, [&](PigeonCandidate const&, size_t) {
+            ++distinct;
+        });
+        keep(distinct);
+    });
+    auto alignments = std::vector<PigeonAlignment>{};
+    measure("dedup_alignments", hits.size(), [&] {
+        alignments = hits;
+        dedup_alignments(alignments, errors);
+        keep(alignments.size());
+    });
+
+    // native index: loading it from a file, rank lookups and backward search
+    auto const index_path = std::filesystem::temp_directory_path() / "kernel_bench.index";
+    visit_occ_table(occ_table, [&]<typename occ_t>(std::type_identity<occ_t>) {
+        auto const text = to_native_text({reference});
+        {
+            auto index  = NativeIndex<occ_t>{text, /*samplingRate=*/16, /*threadNbr=*/1};
+            auto header = IndexHeader{.backend = IndexBackend::native, .occ_table = occ_table};
+            std::ofstream os{index_path, std::ios::binary};
+            cereal::BinaryOutputArchive oarchive{os};
+            write_index_header(os, oarchive, header);
+            oarchive(index);
+        }
+        // what visit_index does, without its progress messages on stderr
+        measure("index_load", 1, [&] {
+            std::ifstream is{index_path, std::ios::binary};
+            read_index_header(is);
+            auto index = NativeIndex<occ_t>{fmindex_collection::cereal_tag{}};
+            cereal::BinaryInputArchive iarchive{is};
+            iarchive(index);
+            keep(index.size());
+        });
+
+        auto const index = NativeIndex<occ_t>{text, /*samplingRate=*/16, /*threadNbr=*/1};
+        auto rank_positions = std::vector<size_t>(1 << 20);
+        for (auto& position : rank_positions) {
+            position = rng() % (index.size() + 1);
+        }
+        measure("occ_rank", rank_positions.size(), [&] {
+            size_t sum = 0;
+            for (size_t i = 0; i < rank_positions.size(); ++i) {
+                sum += index.occ.rank(rank_positions[i], static_cast<uint8_t>(i % 4 + 1));
+            }
+            keep(sum);
+        });
+        measure("backward_search", read_count, [&] {
+            size_t found = 0;
+            for (auto const& read : inputs.reads) {
+                found += backward_search(index, read).len;
+            }
+            keep(found);
+        });
+    });
+    std::filesystem::remove(index_path);
+
+    std::ifstream csv_in{csv_file};
+    bool const csv_empty = csv_in.peek() == std::ifstream::traits_type::eof();
+    std::ofstream csv_out{csv_file, std::ios_base::app};
+    if (csv_empty) {
+        csv_out << "kernel,reference_length,repeat,read_count,read_length,errors,seed,ops,median_ns_per_op,min_ns_per_op\n";
+    }
+    for (auto const& result : results) {
+        csv_out << result.name << "," << reference_length << "," << repeat << "," << read_count << "," << read_length << "," << int{errors} << ","
+                << seed << "," << result.ops << "," << result.median_ns << "," << result.min_ns << "\n";
+    }
+
+    return 0;
+}
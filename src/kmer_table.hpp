@@ -0,0 +1,119 @@
+#ifndef KMER_TABLE_HPP
+#define KMER_TABLE_HPP
+
+#include "fm_native.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+#include <cereal/types/vector.hpp>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+// Maps every k-mer over ACGT to its suffix array interval, a backward search
+// starts with the interval of the last k bases of the query instead of paying
+// k dependent occ lookups. k-mers containing N are not stored, queries ending
+// in such a k-mer fall back to the plain backward search.
+//
+// The intervals are stored with 32 bits, 4^k * 8 bytes in total; only texts
+// of 2^32 or more characters use the 64 bit wide_lb and wide_len instead.
+struct KmerTable {
+    uint8_t k = 0;
+    std::vector<uint32_t> lb;  // indexed by kmer_code()
+    std::vector<uint32_t> len;
+    std::vector<uint64_t> wide_lb;
+    std::vector<uint64_t> wide_len;
+
+    bool empty() const { return k == 0; }
+
+    // fills the table by a depth first traversal over all k-mers, extending
+    // from the last base so that shared suffixes are extended only once
+    template <typename index_t>
+    void build(index_t const& index, uint8_t kmer_length) {
+        k = kmer_length;
+        bool const wide = index.size() > std::numeric_limits<uint32_t>::max();
+        lb.assign(wide ? 0 : size_t{1} << (2 * k), 0);
+        len.assign(wide ? 0 : size_t{1} << (2 * k), 0);
+        wide_lb.assign(wide ? size_t{1} << (2 * k) : 0, 0);
+        wide_len.assign(wide ? size_t{1} << (2 * k) : 0, 0);
+
+        auto rec = [&](auto& self, NativeInterval iv, size_t depth, size_t code) -> void {
+            if (depth == k) {
+                if (wide) {
+                    wide_lb[code]  = iv.lb;
+                    wide_len[code] = iv.len;
+                } else {
+                    lb[code]  = static_cast<uint32_t>(iv.lb);
+                    len[code] = static_cast<uint32_t>(iv.len);
+                }
+                return;
+            }
+            for (uint8_t base = 0; base < 4; ++base) {
+                auto next = extend_left(index, iv, native_symbol(base_to_dna5(base)));
+                self(self, next, depth + 1, code | (size_t{base} << (2 * depth)));
+            }
+        };
+        rec(rec, full_interval(index), 0, 0);
+    }
+
+    // 2-bit code of the last k bases, the first base is the most significant
+    template <typename query_t>
+    std::optional<size_t> kmer_code(query_t const& query) const {
+        auto const size = std::ranges::size(query);
+        if (empty() || size < k) {
+            return std::nullopt;
+        }
+        size_t code = 0;
+        for (size_t i = size - k; i < size; ++i) {
+            auto rank = seqan3::to_rank(query[i]);
+            if (rank == 3) { // N
+                return std::nullopt;
+            }
+            code = (code << 2) | (rank == 4 ? 3 : rank);
+        }
+        return code;
+    }
+
+    // interval of the last k bases of the query, if they are in the table
+    template <typename query_t>
+    std::optional<NativeInterval> lookup(query_t const& query) const {
+        auto code = kmer_code(query);
+        if (!code) {
+            return std::nullopt;
+        }
+        if (!wide_lb.empty()) {
+            return NativeInterval{wide_lb[*code], wide_len[*code]};
+        }
+        return NativeInterval{lb[*code], len[*code]};
+    }
+
+    // backward search that starts from the stored interval of the last k bases
+    template <typename index_t, typename query_t>
+    NativeInterval backward_search(index_t const& index, query_t const& query) const {
+        auto start = lookup(query);
+        if (!start) {
+            return ::backward_search(index, query);
+        }
+        auto iv = *start;
+        for (size_t i = std::ranges::size(query) - k; i > 0 && !iv.empty(); --i) {
+            iv = extend_left(index, iv, native_symbol(query[i - 1]));
+        }
+        return iv;
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        ar(k, lb, len, wide_lb, wide_len);
+    }
+
+private:
+    static seqan3::dna5 base_to_dna5(uint8_t base) {
+        static constexpr uint8_t ranks[] = {0, 1, 2, 4}; // A, C, G, T
+        return seqan3::dna5{}.assign_rank(ranks[base]);
+    }
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// HDR-style histogram of latencies in nanoseconds. Values below 128 get a
+// counter each, larger ones are grouped by their power of two into 64 linear
+// sub-buckets, so a recorded value is off by less than 1/64 of itself. The
+// counters are a fixed array, recording never allocates.
+class LatencyHistogram {
+	private:
+		static constexpr int    sub_bits  = 6;
+		static constexpr size_t sub_count = size_t{1} << sub_bits;
+		// shifts go up to 64 - (sub_bits + 1), the largest bucket holds 2^64 - 1
+		static constexpr size_t bucket_count = (64 - sub_bits + 1) * sub_count;
+
+		// bucket of v: the top sub_bits + 1 bits of v and how far they were shifted
+		static constexpr size_t bucket_of(uint64_t value) {
+			int const shift = std::max(static_cast<int>(std::bit_width(value)), sub_bits + 1) - (sub_bits + 1);
+			return static_cast<size_t>(shift) * sub_count + (value >> shift);
+		}
+
+		// largest value that falls into `bucket`
+		static constexpr uint64_t highest_value(size_t bucket) {
+			if (bucket < 2 * sub_count) return bucket;
+			auto const shift = bucket / sub_count - 1;
+			auto const top   = bucket - shift * sub_count;
+			return ((top + 1) << shift) - 1;
+		}
+
+		std::array<uint64_t, bucket_count> counts{};
+		uint64_t total = 0;
+		uint64_t max   = 0;
+
+	public:
+		void record(uint64_t value, uint64_t count = 1) {
+			counts[bucket_of(value)] += count;
+			total += count;
+			max = std::max(max, value);
+		}
+
+		uint64_t count() const { return total; }
+
+		// smallest recorded value (up to the bucket width) that `quantile` of
+		// all values do not exceed, 0 if nothing was recorded
+		uint64_t percentile(double quantile) const {
+			auto const rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * total)));
+			uint64_t seen = 0;
+			for (size_t bucket = 0; bucket < counts.size(); ++bucket) {
+				seen += counts[bucket];
+				if (seen >= rank) return std::min(highest_value(bucket), max);
+			}
+			return max;
+		}
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define HAS_MMAP 1
+#endif
+
+MappedFile::MappedFile(std::filesystem::path const& path) {
+	length = std::filesystem::file_size(path);
+#ifdef HAS_MMAP
+	if (auto fd = ::open(path.c_str(), O_RDONLY); fd >= 0) {
+		if (length > 0) {
+			auto result = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+			if (result != MAP_FAILED) {
+				mapping = result;
+			}
+		}
+		::close(fd);
+	}
+	if (mapping || length == 0) return;
+#endif
+	std::ifstream is{path, std::ios::binary};
+	if (!is) {
+		throw std::runtime_error{"could not open " + path.string()};
+	}
+	buffer.resize(length);
+	is.read(buffer.data(), length);
+}
+
+MappedFile::~MappedFile() {
+#ifdef HAS_MMAP
+	if (mapping) {
+		::munmap(mapping, length);
+	}
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: mapping{std::exchange(other.mapping, nullptr)}, length{std::exchange(other.length, 0)}, buffer{std::move(other.buffer)} {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	std::swap(mapping, other.mapping);
+	std::swap(length, other.length);
+	std::swap(buffer, other.buffer);
+	return *this;
+}
+
+std::span<char const> MappedFile::bytes() const {
+	if (mapping) return {static_cast<char const*>(mapping), length};
+	return {buffer.data(), buffer.size()};
+}
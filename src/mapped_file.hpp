@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+// Read-only view of a whole file. The file is mapped into memory where mmap
+// is available, so only the pages that are used are read and they are shared
+// between processes; elsewhere it is read into a buffer.
+class MappedFile {
+	private:
+		void*             mapping = nullptr;
+		size_t            length  = 0;
+		std::vector<char> buffer; // used if the file could not be mapped
+
+	public:
+		explicit MappedFile(std::filesystem::path const& path);
+		~MappedFile();
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		MappedFile(MappedFile const&) = delete;
+		MappedFile& operator=(MappedFile const&) = delete;
+
+		std::span<char const> bytes() const;
+};
+
+#endif
@@ -1,7 +1,15 @@
 #include "benchmark.hpp"
+#include "naive_search.hpp"
+#include "query_dedup.hpp"
+#include "query_pipeline.hpp"
+#include "result_sink.hpp"
+#include "strands.hpp"
 
+#include <chrono>
 #include <sstream>
 #include <fstream>
+#include <limits>
+#include <span>
 
 #include <seqan3/alphabet/nucleotide/dna5.hpp>
 #include <seqan3/argument_parser/all.hpp>
@@ -10,19 +18,6 @@
 #include <seqan3/search/fm_index/fm_index.hpp>
 #include <seqan3/search/search.hpp>
 
-// prints out all occurences of query inside of ref
-void findOccurences(std::vector<seqan3::dna5> const& ref, std::vector<seqan3::dna5> const& query, bool quiet) {
-    for (long unsigned int i = 0; i <= ref.size()-query.size(); i++) {
-	    for (long unsigned int j = 0; j <= query.size(); j++) {
-		if (ref[i+j] != query[j])
-			break;
-
-		if ((j == query.size()-1) && !(quiet))
-			seqan3::debug_stream << query << "\n";
-	    }
-    }
-}
-
 int main(int argc, char const* const* argv) {
     seqan3::argument_parser parser{"naive_search", argc, argv, seqan3::update_notifications::off};
 
@@ -41,25 +36,114 @@ int main(int argc, char const* const* argv) {
     auto quiet = false;
     parser.add_option(quiet, '\0', "quiet", "do not print matches");
 
+    auto output_file = std::filesystem::path{"-"};
+    parser.add_option(output_file, '\0', "output", "file the matches are written to, - for stdout");
+
+    auto format_name = std::string{"sam"};
+    parser.add_option(format_name, '\0', "format", "output format of the matches, sam or binary",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{result_format_names});
+
+    auto locate = LocateOptions{};
+    parser.add_flag(locate.count_only, '\0', "count-only", "only report the number of occurrences per query");
+    parser.add_option(locate.max_hits, '\0', "max-hits", "report at most this many occurrences per query, 0 reports all");
+
+    auto both = false;
+    parser.add_flag(both, '\0', "both-strands", "also search the reverse complement of every query, --max-hits applies to each strand");
+
+    auto stream = false;
+    parser.add_flag(stream, '\0', "stream", "search while reading the queries instead of loading all of them first");
+
+    auto use_dedup = false;
+    parser.add_flag(use_dedup, '\0', "dedup", "search every distinct query once and report its results for all queries with the same sequence (not with --stream)");
+
     try {
          parser.parse();
     } catch (seqan3::argument_parser_error const& ext) {
         seqan3::debug_stream << "Parsing error. " << ext.what() << "\n";
         return EXIT_FAILURE;
     }
+    if (use_dedup && stream) {
+        seqan3::debug_stream << "--dedup needs all queries in memory and does not support --stream\n";
+        return EXIT_FAILURE;
+    }
 
 
-    // loading our files
+    // loading our files, the phases of the run are written to cpp_benchmark_phases.csv
+    auto load_benchmark = Benchmark("naive_load", reference_file, query_file, 0);
     auto reference_stream = seqan3::sequence_file_input{reference_file};
-    auto query_stream     = seqan3::sequence_file_input{query_file};
 
     // read reference into memory
     std::vector<std::vector<seqan3::dna5>> reference;
     for (auto& record : reference_stream) {
         reference.push_back(record.sequence());
     }
+    load_benchmark.phase("load_reference");
+
+    auto writer = ResultWriter{output_file, parse_result_format(format_name, quiet), locate.count_only};
+    auto const format = writer.get_format();
+    auto const max_hits = locate.max_hits ? locate.max_hits : std::numeric_limits<size_t>::max();
+
+    auto const method_suffix = (both ? "_both_strands" : "") + locate.method_suffix();
+
+    // with --dedup the results of a distinct query are reported for all of its copies
+    QueryDedup const* fan_out = nullptr;
+
+    // searches a query in all references and formats its hits, or its count, into `out`
+    auto search_query = [&](std::span<seqan3::dna5 const> query, size_t query_id, std::string& out) {
+        size_t total = 0;
+        auto search_strand = [&](std::span<seqan3::dna5 const> strand, bool reverse) {
+            size_t count = 0;
+            for (size_t reference_id = 0; reference_id < reference.size() && count < max_hits; reference_id++) {
+                findOccurences(reference[reference_id], strand, [&](size_t position) {
+                    if (!locate.count_only) {
+                        for_each_original(fan_out, query_id, [&](size_t id) {
+                            append_hit(out, format, {id, reference_id, position, 0, reverse});
+                        });
+                    }
+                    return ++count < max_hits;
+                });
+            }
+            total += count;
+        };
+        search_strand(query, false);
+        if (both) {
+            auto reverse = std::vector<seqan3::dna5>{};
+            reverse_complement(query, reverse);
+            search_strand(reverse, true);
+        }
+        if (locate.count_only) {
+            for_each_original(fan_out, query_id, [&](size_t id) {
+                append_count(out, format, id, total);
+            });
+        }
+    };
+
+    if (stream) {
+        // parse, search and print batches of queries concurrently, see query_pipeline.hpp
+        auto benchmark = Benchmark("naive_stream" + method_suffix, reference_file, query_file, 0);
+        int read_num = 0;
+        run_query_pipeline(query_file, number_of_queries, [&](QueryBatch const& batch, std::string& out) {
+            for (size_t i = 0; i < batch.queries.size(); i++) {
+                auto const start = std::chrono::steady_clock::now();
+                search_query(batch.queries[i], batch.first_id + i, out);
+                benchmark.record_query(std::chrono::steady_clock::now() - start);
+            }
+        }, [&](OutputBatch const& batch) {
+            writer.write(batch.text);
+            for (size_t i = 0; i < batch.query_count; i++) {
+                if (read_num % 10 == 0) {
+                    benchmark.write(read_num);
+                }
+                read_num++;
+            }
+        });
+        writer.flush();
+        benchmark.phase("search"); // includes the output, which overlaps with it
+        return 0;
+    }
 
     // read query into memory
+    auto query_stream = seqan3::sequence_file_input{query_file};
     std::vector<std::vector<seqan3::dna5>> queries;
     for (auto& record : query_stream) {
         queries.push_back(record.sequence());
@@ -73,18 +157,38 @@ int main(int argc, char const* const* argv) {
     }
     queries.resize(number_of_queries); // will reduce the amount of searches
 
-    auto benchmark = Benchmark("naive", reference_file, query_file, 0);
-    //! search for all occurences of queries inside of reference
-    for (auto& r : reference) {
-	int read_num = 0;
-        for (auto& q : queries) {
-            findOccurences(r, q, quiet);
-	    if (read_num % 10 == 0) {
-		    benchmark.write(read_num);
-	    }
-	    read_num++;
+    // with --dedup only the distinct queries are searched, see query_dedup.hpp
+    auto dedup = QueryDedup{};
+    if (use_dedup) {
+        dedup   = dedup_queries(queries);
+        fan_out = &dedup;
+    }
+    auto const searched = use_dedup ? dedup.unique : std::vector<std::span<seqan3::dna5 const>>(queries.begin(), queries.end());
+    load_benchmark.phase("load_queries");
 
+    auto benchmark = Benchmark((use_dedup ? "naive_dedup" : "naive") + method_suffix, reference_file, query_file, 0);
+    //! search for all occurences of queries inside of reference
+    auto out = std::string{};
+    int read_num = 0;
+    for (size_t query_id = 0; query_id < searched.size(); query_id++) {
+        auto const start = std::chrono::steady_clock::now();
+        search_query(searched[query_id], query_id, out);
+        benchmark.record_query(std::chrono::steady_clock::now() - start);
+        if (out.size() >= ResultWriter::buffer_size / 4) {
+            writer.write(out);
+            out.clear();
         }
+	if (read_num % 10 == 0) {
+		benchmark.write(read_num);
+	}
+	read_num++;
+    }
+    writer.write(out);
+    benchmark.phase("search");
+    writer.flush();
+    benchmark.phase("output");
+    if (use_dedup) {
+        benchmark.write_stat("cache_hit_rate", dedup.hit_rate());
     }
 
     return 0;
@@ -0,0 +1,27 @@
+#ifndef NAIVE_SEARCH_HPP
+#define NAIVE_SEARCH_HPP
+
+#include <span>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+// reports all occurences of query inside of ref by calling report(position),
+// the search stops as soon as report returns false
+template <typename report_t>
+void findOccurences(std::vector<seqan3::dna5> const& ref, std::span<seqan3::dna5 const> query, report_t&& report) {
+    for (long unsigned int i = 0; i <= ref.size()-query.size(); i++) {
+	    for (long unsigned int j = 0; j <= query.size(); j++) {
+		if (ref[i+j] != query[j])
+			break;
+
+		if (j == query.size()-1) {
+			if (!report(i))
+				return;
+			break;
+		}
+	    }
+    }
+}
+
+#endif
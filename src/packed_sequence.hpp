@@ -0,0 +1,151 @@
+#ifndef PACKED_SEQUENCE_HPP
+#define PACKED_SEQUENCE_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+// 2-bit code of a base, A=0 C=1 G=2 T=3; N is stored as A and listed separately
+inline uint64_t packed_code(seqan3::dna5 base) {
+    constexpr uint8_t codes[] = {0, 1, 2, 0, 3}; // by dna5 rank: A C G N T
+    return codes[base.to_rank()];
+}
+
+// a run [begin, end) of Ns
+struct NRun {
+    uint64_t begin;
+    uint64_t end;
+};
+
+// A sequence with 32 bases per 64 bit word, the first base in the lowest bits.
+// N runs are kept as a list instead of a mask with one bit per base, they are
+// rare but long in assemblies. The view does not own its memory, which is
+// either a PackedSequence or a mapped index file (see reference_text.hpp).
+struct PackedView {
+    size_t                    length = 0;
+    std::span<uint64_t const> words;  // one extra word at the end, see window()
+    std::span<NRun const>     n_runs; // in order
+
+    uint64_t code(size_t i) const {
+        return (words[i / 32] >> (2 * (i % 32))) & 0b11;
+    }
+
+    bool is_n(size_t i) const {
+        auto run = std::ranges::upper_bound(n_runs, i, {}, &NRun::begin);
+        return run != n_runs.begin() && std::prev(run)->end > i;
+    }
+
+    // the 32 bases starting at `begin`, positions past the end read as A
+    uint64_t window(size_t begin) const {
+        auto const word  = begin / 32;
+        auto const shift = 2 * (begin % 32);
+        if (shift == 0) return words[word];
+        return (words[word] >> shift) | (words[word + 1] << (64 - shift));
+    }
+};
+
+// owns the memory of a PackedView
+struct PackedSequence {
+    size_t                length = 0;
+    std::vector<uint64_t> words;
+    std::vector<NRun>     n_runs;
+
+    PackedSequence() = default;
+    explicit PackedSequence(std::span<seqan3::dna5 const> sequence) {
+        assign(sequence);
+    }
+
+    // packs `sequence`, reusing the memory of the previous one
+    void assign(std::span<seqan3::dna5 const> sequence) {
+        length = sequence.size();
+        words.assign(length / 32 + 2, 0);
+        n_runs.clear();
+        for (size_t i = 0; i < length; ++i) {
+            words[i / 32] |= packed_code(sequence[i]) << (2 * (i % 32));
+            if (sequence[i].to_rank() == 3) { // N
+                if (!n_runs.empty() && n_runs.back().end == i) {
+                    ++n_runs.back().end;
+                } else {
+                    n_runs.push_back({i, i + 1});
+                }
+            }
+        }
+    }
+
+    PackedView view() const {
+        return {length, words, n_runs};
+    }
+};
+
+// number of bases that differ between two words of packed bases
+inline int word_mismatches(uint64_t a, uint64_t b) {
+    auto x = a ^ b;
+    return std::popcount((x | (x >> 1)) & 0x5555'5555'5555'5555);
+}
+
+// `limit` is either an int or a std::integral_constant, so the early exit
+// compares against a constant for the common error counts
+template <typename limit_t>
+int packed_hamming_impl(PackedView const& reference, PackedView const& query, size_t begin, limit_t limit) {
+    int mismatches = 0;
+    size_t const full_words = query.length / 32;
+    for (size_t w = 0; w < full_words; ++w) {
+        mismatches += word_mismatches(reference.window(begin + 32 * w), query.words[w]);
+        if (mismatches > limit) return mismatches;
+    }
+    if (auto const rest = query.length % 32) {
+        auto const mask = (uint64_t{1} << (2 * rest)) - 1;
+        mismatches += word_mismatches(reference.window(begin + 32 * full_words) & mask, query.words[full_words]);
+        if (mismatches > limit) return mismatches;
+    }
+
+    // N is packed as A, so a N opposite of an A was counted as a match; the
+    // packed count is never too high, which makes the early exits above safe
+    auto const end = begin + query.length;
+    auto first = std::ranges::upper_bound(reference.n_runs, begin, {}, &NRun::end);
+    for (auto run = first; run != reference.n_runs.end() && run->begin < end; ++run) {
+        for (size_t i = std::max<size_t>(run->begin, begin); i < std::min<size_t>(run->end, end); ++i) {
+            bool const query_n = query.is_n(i - begin);
+            mismatches += int{!query_n} - int{query.code(i - begin) != 0};
+        }
+    }
+    for (auto run : query.n_runs) {
+        for (size_t i = run.begin; i < run.end; ++i) {
+            if (!reference.is_n(begin + i)) {
+                mismatches += 1 - int{reference.code(begin + i) != 0};
+            }
+        }
+    }
+    return mismatches;
+}
+
+// Counts the mismatches of `query` against `reference` starting at `begin`,
+// bases compare like seqan3::dna5 (an N only matches an N). Counting stops
+// as soon as more than `max_errors` mismatches were found, the result is then
+// larger than max_errors but not necessarily exact. Each supported error count
+// gets its own instantiation with a constant limit.
+template <int max_errors>
+int packed_hamming(PackedView const& reference, PackedView const& query, size_t begin) {
+    return packed_hamming_impl(reference, query, begin, std::integral_constant<int, max_errors>{});
+}
+
+inline int packed_hamming(PackedView const& reference, PackedView const& query, size_t begin, int max_errors) {
+    switch (max_errors) {
+        case 0: return packed_hamming<0>(reference, query, begin);
+        case 1: return packed_hamming<1>(reference, query, begin);
+        case 2: return packed_hamming<2>(reference, query, begin);
+        case 3: return packed_hamming<3>(reference, query, begin);
+        case 4: return packed_hamming<4>(reference, query, begin);
+        default: return packed_hamming_impl(reference, query, begin, max_errors);
+    }
+}
+
+#endif
@@ -0,0 +1,66 @@
+#include "perf_counters.hpp"
+
+#include <utility>
+
+#if __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HAS_PERF_EVENT 1
+#endif
+
+PerfCounters::PerfCounters() {
+	fds.fill(-1);
+#ifdef HAS_PERF_EVENT
+	auto cache_miss = [](uint64_t cache) {
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	};
+	// in the order of names
+	std::array<std::pair<uint32_t, uint64_t>, count> const events{{
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}, // last level cache on most cpus
+		{PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	}};
+	for (size_t i = 0; i < count; ++i) {
+		perf_event_attr attr{};
+		attr.size           = sizeof(attr);
+		attr.type           = events[i].first;
+		attr.config         = events[i].second;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+		attr.inherit        = 1; // threads of the searches count once they are joined
+		attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		fds[i] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+	}
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef HAS_PERF_EVENT
+	for (auto fd : fds) {
+		if (fd >= 0) {
+			::close(fd);
+		}
+	}
+#endif
+}
+
+PerfCounters::Values PerfCounters::read() const {
+	auto values = Values{};
+#ifdef HAS_PERF_EVENT
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t data[3]; // value, time enabled, time running
+		if (fds[i] < 0 || ::read(fds[i], data, sizeof(data)) != sizeof(data)) continue;
+		if (data[2] == 0) {
+			values[i] = 0; // never scheduled
+		} else if (data[2] == data[1]) {
+			values[i] = data[0];
+		} else {
+			values[i] = static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+		}
+	}
+#endif
+	return values;
+}
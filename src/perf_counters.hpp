@@ -0,0 +1,35 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Hardware counters of the calling process, including the threads it starts
+// later, read through perf_event_open. A counter the kernel refuses (see
+// /proc/sys/kernel/perf_event_paranoid, or an event this cpu does not have)
+// stays closed and reads as nullopt, as do all of them where there is no
+// perf_event_open. Counters are user space only, so they also work with a
+// paranoid level of 2.
+class PerfCounters {
+	public:
+		static constexpr size_t count = 5;
+		static constexpr std::array<char const*, count> names{"cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses"};
+		using Values = std::array<std::optional<uint64_t>, count>;
+
+	private:
+		std::array<int, count> fds;
+
+	public:
+		PerfCounters();
+		~PerfCounters();
+		PerfCounters(PerfCounters const&) = delete;
+		PerfCounters& operator=(PerfCounters const&) = delete;
+
+		// totals since the counters were opened, scaled up if the kernel had
+		// to multiplex them
+		Values read() const;
+};
+
+#endif
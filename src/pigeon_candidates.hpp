@@ -0,0 +1,173 @@
+#ifndef PIGEON_CANDIDATES_HPP
+#define PIGEON_CANDIDATES_HPP
+
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+#include "packed_sequence.hpp"
+#include "result_sink.hpp"
+#include "seed_partition.hpp"
+
+// a possible occurrence of a read: the read `read` of a batch would start at
+// `diagonal` of the reference `reference_id`, every exact piece hit votes for
+// one diagonal
+struct PigeonCandidate {
+    uint64_t read;
+    uint64_t reference_id;
+    uint64_t diagonal;
+
+    auto operator<=>(PigeonCandidate const&) const = default;
+};
+
+// an alignment found by verifying the candidate on `diagonal`
+struct PigeonAlignment {
+    Hit      hit;
+    uint64_t diagonal;
+};
+
+// Buffers of the pigeonhole search that are reused for every batch of reads
+// of a thread, so searching does not allocate once they have grown.
+struct PigeonArena {
+    std::vector<std::span<seqan3::dna5 const>>  reads;        // the reads of the batch, see --both-strands
+    std::vector<std::vector<seqan3::dna5>>      reverse;      // their reverse complements
+    std::vector<std::span<seqan3::dna5 const>>  pieces;       // the pieces of all reads of the batch
+    std::vector<size_t>                         piece_read;   // read of each piece
+    std::vector<size_t>                         piece_offset; // position of each piece in its read
+    std::vector<PigeonCandidate>                candidates;
+    std::vector<PigeonCandidate>                scratch; // second buffer of the radix sort
+    PackedSequence                              query;   // the current read, for packed_hamming
+
+    // adaptive partitioning, see seed_partition.hpp
+    std::vector<std::span<seqan3::dna5 const>>  partition_pieces; // all pieces that are counted
+    std::vector<size_t>                         partition_counts;
+    std::vector<size_t>                         boundaries;       // of the pieces of the current read
+    std::vector<std::array<uint8_t, partition_options>> choices;
+
+    std::vector<PigeonAlignment>                alignments; // of the current read with --error-model edit
+
+    // statistics for the benchmark output
+    size_t candidate_count    = 0; // piece hits
+    size_t verification_count = 0; // packed_hamming calls
+};
+
+// LSD radix sort of the candidates by (read, reference_id, diagonal) with one pass
+// per byte, bytes that are zero in all keys are skipped. Short lists are
+// sorted by comparison instead.
+inline void radix_sort(std::vector<PigeonCandidate>& candidates, std::vector<PigeonCandidate>& scratch) {
+    if (candidates.size() < 64) {
+        std::ranges::sort(candidates);
+        return;
+    }
+    uint64_t max_read      = 0;
+    uint64_t max_reference = 0;
+    uint64_t max_diagonal  = 0;
+    for (auto const& c : candidates) {
+        max_read      = std::max(max_read, c.read);
+        max_reference = std::max(max_reference, c.reference_id);
+        max_diagonal  = std::max(max_diagonal, c.diagonal);
+    }
+
+    scratch.resize(candidates.size());
+    auto pass = [&](uint64_t PigeonCandidate::* key, unsigned shift) {
+        auto offsets = std::array<size_t, 256>{};
+        for (auto const& c : candidates) {
+            ++offsets[(c.*key >> shift) & 0xff];
+        }
+        size_t sum = 0;
+        for (auto& offset : offsets) {
+            sum += std::exchange(offset, sum);
+        }
+        for (auto const& c : candidates) {
+            scratch[offsets[(c.*key >> shift) & 0xff]++] = c;
+        }
+        candidates.swap(scratch);
+    };
+    for (unsigned shift = 0; shift < 64 && (max_diagonal >> shift) > 0; shift += 8) {
+        pass(&PigeonCandidate::diagonal, shift);
+    }
+    for (unsigned shift = 0; shift < 64 && (max_reference >> shift) > 0; shift += 8) {
+        pass(&PigeonCandidate::reference_id, shift);
+    }
+    for (unsigned shift = 0; shift < 64 && (max_read >> shift) > 0; shift += 8) {
+        pass(&PigeonCandidate::read, shift);
+    }
+}
+
+// calls `f(candidate, support)` once per distinct candidate of a sorted list,
+// `support` is the number of pieces that voted for it
+template <typename F>
+void for_each_candidate(std::span<PigeonCandidate const> candidates, F&& f) {
+    for (size_t i = 0; i < candidates.size();) {
+        size_t j = i + 1;
+        while (j < candidates.size() && candidates[j] == candidates[i]) {
+            ++j;
+        }
+        f(candidates[i], j - i);
+        i = j;
+    }
+}
+
+// Number of votes of the sorted candidates of a read for diagonals within
+// `radius` of `candidate` on its reference. With edit distance an indel
+// between two pieces moves the votes of the later ones to a neighbouring
+// diagonal, so they are counted together.
+inline size_t window_support(std::span<PigeonCandidate const> candidates, PigeonCandidate const& candidate, size_t radius) {
+    auto const low  = PigeonCandidate{candidate.read, candidate.reference_id, candidate.diagonal - std::min<size_t>(candidate.diagonal, radius)};
+    auto const high = PigeonCandidate{candidate.read, candidate.reference_id, candidate.diagonal + radius};
+    return std::ranges::upper_bound(candidates, high) - std::ranges::lower_bound(candidates, low);
+}
+
+// Verifying neighbouring diagonals of one occurrence finds it several times,
+// at the same or at shifted starts. Alignments of a read on the same
+// reference and strand form a cluster with the first one, the one with the
+// smallest start, if they start within `max_errors` of it and were verified
+// from a neighbouring diagonal, within 2 * max_errors of its diagonal as an
+// alignment starts within max_errors of its own; alignments with the same
+// start always share a cluster. A cluster keeps its alignment with the
+// fewest errors; other alignments with as few errors that start on their
+// own diagonal are distinct occurrences, e.g. of a tandem repeat, and are
+// kept as well.
+inline void dedup_alignments(std::vector<PigeonAlignment>& alignments, size_t max_errors) {
+    std::ranges::sort(alignments, {}, [](PigeonAlignment const& a) {
+        return std::tuple{a.hit.reference_id, a.hit.reverse, a.hit.position, a.hit.errors};
+    });
+    auto distance = [](uint64_t a, uint64_t b) { return a < b ? b - a : a - b; };
+
+    size_t kept = 0;
+    for (size_t first = 0; first < alignments.size();) {
+        auto const f = alignments[first];
+        auto end = first + 1;
+        uint8_t fewest = f.hit.errors;
+        while (end < alignments.size()) {
+            auto const& a = alignments[end];
+            bool const same_start = a.hit.position == alignments[end - 1].hit.position;
+            if (a.hit.reference_id != f.hit.reference_id || a.hit.reverse != f.hit.reverse
+                || a.hit.position - f.hit.position > max_errors || (!same_start && distance(a.diagonal, f.diagonal) > 2 * max_errors)) break;
+            fewest = std::min(fewest, a.hit.errors);
+            ++end;
+        }
+        size_t const cluster_begin = kept;
+        for (size_t i = first; i < end; ++i) {
+            auto const a = alignments[i];
+            if (a.hit.errors != fewest) continue;
+            bool const anchored = a.hit.position == a.diagonal;
+            bool const new_start = kept == cluster_begin || alignments[kept - 1].hit.position != a.hit.position;
+            if (kept == cluster_begin || (anchored && new_start)) {
+                alignments[kept++] = a;
+            }
+        }
+        first = end;
+    }
+    alignments.resize(kept);
+}
+
+#endif
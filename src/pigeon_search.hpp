@@ -0,0 +1,203 @@
+#ifndef PIGEON_SEARCH_HPP
+#define PIGEON_SEARCH_HPP
+
+#include "banded_alignment.hpp"
+#include "fm_search.hpp"
+#include "index_file.hpp"
+#include "packed_sequence.hpp"
+#include "pigeon_candidates.hpp"
+#include "result_sink.hpp"
+#include "seed_partition.hpp"
+#include "strands.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+// settings of the pigeonhole search, see fmindex_pigeon_search.cpp
+struct PigeonOptions {
+    uint8_t errors      = 0;
+    bool    edit        = false; // edit distance instead of mismatches only, verified by banded_edit_distance
+    bool    adaptive    = false; // adaptive instead of equal pieces, see seed_partition.hpp
+    bool    extra_piece = false; // errors + 2 pieces, a candidate needs two of them
+    bool    both        = false; // also search the reverse complement of every read
+};
+
+// Searches a batch of reads, the first one has the id `first_id`: the pieces
+// of all reads go into a single fm_search call on `index`, their hits are
+// scattered back to the reads as candidates that are then verified read by
+// read against `reference` (indexed by reference id, PackedView sequences).
+// `report_hit(hit)` is called for up to options.locate.max_hits verified
+// occurrences per strand of a read, with options.locate.count_only
+// `report_count(query_id, count)` once per read instead. The pieces are
+// always searched on the calling thread.
+template <typename index_t, typename reference_t, typename batch_t, typename report_hit_t, typename report_count_t>
+void pigeon_search(index_t const& index, IndexExtras const& extras, reference_t const& reference,
+                   batch_t const& batch, size_t first_id, PigeonOptions const& pigeon, SearchOptions const& options,
+                   PigeonArena& arena, report_hit_t&& report_hit, report_count_t&& report_count) {
+    // every piece hit is needed to find the candidates, count_only and
+    // max_hits apply to the verified matches of a read
+    auto piece_options = options;
+    piece_options.threads     = 1;
+    piece_options.locate      = {};
+    piece_options.query_timer = {};
+    piece_options.chunk_timer = {};
+    auto const max_hits = options.locate.max_hits ? options.locate.max_hits : std::numeric_limits<size_t>::max();
+    auto const number_of_errors = pigeon.errors;
+    bool const edit        = pigeon.edit;
+    bool const extra_piece = pigeon.extra_piece;
+    bool const both        = pigeon.both;
+
+    // with --both-strands every read is followed by its reverse complement,
+    // the pieces of both strands are searched together
+    size_t const strands = both ? 2 : 1;
+    arena.reads.clear();
+    arena.reverse.resize(std::max(arena.reverse.size(), batch.size()));
+    for (size_t i = 0; i < batch.size(); i++) {
+        arena.reads.emplace_back(batch[i]);
+        if (both) {
+            reverse_complement(batch[i], arena.reverse[i]);
+            arena.reads.emplace_back(arena.reverse[i]);
+        }
+    }
+    std::span<std::span<seqan3::dna5 const> const> const reads{arena.reads};
+
+    // with k errors at least one of k+1 pieces matches exactly and at least
+    // two of k+2 pieces, a read shorter than that has empty pieces and is
+    // skipped
+    size_t const piece_count = number_of_errors + 1 + extra_piece;
+    size_t const min_support = extra_piece ? 2 : 1;
+
+    // the adaptive partition counts all pieces it considers with a single call
+    if (pigeon.adaptive) {
+        arena.partition_pieces.clear();
+        arena.partition_counts.clear();
+        for (auto const& read : reads) {
+            if (read.size() < piece_count) continue;
+            for_each_partition_piece(read.size(), piece_count, [&](size_t begin, size_t end) {
+                arena.partition_pieces.emplace_back(read.data() + begin, end - begin);
+            });
+        }
+        fm_count(index, arena.partition_pieces, 0, [&](size_t, size_t count) {
+            arena.partition_counts.push_back(count);
+        }, extras, piece_options);
+    }
+
+    arena.pieces.clear();
+    arena.piece_read.clear();
+    arena.piece_offset.clear();
+    size_t next_count = 0;
+    for (size_t r = 0; r < reads.size(); r++) {
+        auto const& read = reads[r];
+        if (read.size() < piece_count) continue;
+        if (pigeon.adaptive) {
+            auto const considered = partition_piece_count(read.size(), piece_count);
+            choose_partition(read.size(), piece_count, std::span{arena.partition_counts}.subspan(next_count, considered),
+                             arena.boundaries, arena.choices);
+            next_count += considered;
+        } else {
+            arena.boundaries.resize(piece_count + 1);
+            for (size_t i = 0; i <= piece_count; i++) {
+                arena.boundaries[i] = piece_start(read.size(), piece_count, i);
+            }
+        }
+        for (size_t i = 0; i < piece_count; i++) {
+            auto start = arena.boundaries[i];
+            arena.pieces.emplace_back(read.data() + start, arena.boundaries[i + 1] - start);
+            arena.piece_read.push_back(r);
+            arena.piece_offset.push_back(start);
+        }
+    }
+
+    // every piece hit votes for the diagonal on which its read would start,
+    // with edit distance indels may shift the read by up to k positions
+    size_t const slack = edit ? number_of_errors : 0;
+    arena.candidates.clear();
+    fm_search(index, arena.pieces, 0, [&](size_t piece_id, size_t reference_id, size_t position) {
+        auto read  = arena.piece_read[piece_id];
+        auto start = arena.piece_offset[piece_id];
+        if (position + slack < start || position + reads[read].size() > reference[reference_id].length + start + slack) {
+            return; // the read would not fit into the reference
+        }
+        // a read that would start before the reference votes for diagonal 0
+        arena.candidates.push_back({read, reference_id, position - std::min(position, start)});
+    }, extras, piece_options);
+    arena.candidate_count += arena.candidates.size();
+    radix_sort(arena.candidates, arena.scratch);
+
+    auto next = arena.candidates.begin();
+    size_t strand_total = 0; // hits of the strands of the current read so far
+    for (size_t r = 0; r < reads.size(); r++) {
+        size_t const query_id = first_id + r / strands;
+        bool const reverse    = r % strands == 1;
+        auto first = next;
+        while (next != arena.candidates.end() && next->read == r) {
+            ++next;
+        }
+        if (first != next && !edit) {
+            arena.query.assign(reads[r]);
+        }
+
+        // a diagonal supported by all pieces is an exact match, all others
+        // can have up to k errors spread over the remaining pieces
+        // unless too few pieces support them
+        size_t count = 0;
+        auto report = [&](Hit const& hit) {
+            if (count++ < max_hits && !options.locate.count_only) {
+                report_hit(hit);
+            }
+        };
+        // alignments found from neighbouring diagonals overlap, they are
+        // only reported after all candidates of the read were verified
+        arena.alignments.clear();
+        auto found = [&](Hit const& hit, uint64_t diagonal) {
+            if (edit) {
+                arena.alignments.push_back({hit, diagonal});
+            } else {
+                report(hit);
+            }
+        };
+        std::span<PigeonCandidate const> const read_candidates{first, next};
+        for_each_candidate(read_candidates, [&](PigeonCandidate const& candidate, size_t support) {
+            if (support == piece_count && candidate.diagonal >= slack) { // not a clamped diagonal
+                found({query_id, candidate.reference_id, candidate.diagonal, 0, reverse}, candidate.diagonal);
+                return;
+            }
+            if (edit) {
+                support = window_support(read_candidates, candidate, number_of_errors);
+            }
+            if (support < min_support) return;
+            ++arena.verification_count;
+            if (edit) {
+                auto alignment = banded_edit_distance(reference[candidate.reference_id], reads[r], candidate.diagonal, number_of_errors);
+                if (alignment.errors <= number_of_errors) {
+                    found({query_id, candidate.reference_id, alignment.begin, static_cast<uint8_t>(alignment.errors), reverse}, candidate.diagonal);
+                }
+                return;
+            }
+            auto mismatches = packed_hamming(reference[candidate.reference_id], arena.query.view(), candidate.diagonal, number_of_errors);
+            if (mismatches <= number_of_errors) {
+                found({query_id, candidate.reference_id, candidate.diagonal, static_cast<uint8_t>(mismatches), reverse}, candidate.diagonal);
+            }
+        });
+        if (edit) {
+            dedup_alignments(arena.alignments, number_of_errors);
+            for (auto const& alignment : arena.alignments) {
+                report(alignment.hit);
+            }
+        }
+        strand_total += count;
+        if (r % strands == strands - 1) {
+            if (options.locate.count_only) {
+                report_count(query_id, strand_total);
+            }
+            strand_total = 0;
+        }
+    }
+}
+
+#endif
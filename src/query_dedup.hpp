@@ -0,0 +1,107 @@
+#ifndef QUERY_DEDUP_HPP
+#define QUERY_DEDUP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+#include "packed_sequence.hpp"
+
+// hash of a read over its bases packed 32 to a word like in packed_sequence.hpp,
+// reads that only differ by N against A are told apart by the equality check
+struct PackedReadHash {
+    static uint64_t mix(uint64_t x) { // splitmix64 finalizer
+        x ^= x >> 30;
+        x *= 0xbf58'476d'1ce4'e5b9;
+        x ^= x >> 27;
+        x *= 0x94d0'49bb'1331'11eb;
+        return x ^ (x >> 31);
+    }
+
+    size_t operator()(std::span<seqan3::dna5 const> read) const {
+        uint64_t hash = read.size();
+        uint64_t word = 0;
+        for (size_t i = 0; i < read.size(); ++i) {
+            word = (word << 2) | packed_code(read[i]);
+            if (i % 32 == 31) {
+                hash = mix(hash ^ word);
+                word = 0;
+            }
+        }
+        return mix(hash ^ word);
+    }
+};
+
+struct ReadEqual {
+    bool operator()(std::span<seqan3::dna5 const> a, std::span<seqan3::dna5 const> b) const {
+        return std::ranges::equal(a, b);
+    }
+};
+
+// The distinct queries of a query set (--dedup). Every distinct query is
+// searched once and its results are fanned out to the ids of all queries
+// with the same sequence, which also covers the copies made for --query_ct.
+struct QueryDedup {
+    std::vector<std::span<seqan3::dna5 const>> unique;  // in order of their first occurrence
+    std::vector<size_t>                        offsets; // ids of unique[u] are ids[offsets[u], offsets[u + 1])
+    std::vector<size_t>                        ids;
+
+    std::span<size_t const> originals(size_t u) const {
+        return std::span{ids}.subspan(offsets[u], offsets[u + 1] - offsets[u]);
+    }
+
+    // fraction of the queries whose results came from an earlier query
+    double hit_rate() const {
+        return ids.empty() ? 0.0 : 1.0 - static_cast<double>(unique.size()) / ids.size();
+    }
+};
+
+// finds the distinct queries, the spans of the result point into `queries`
+inline QueryDedup dedup_queries(std::vector<std::vector<seqan3::dna5>> const& queries) {
+    auto dedup = QueryDedup{};
+    auto first = std::unordered_map<std::span<seqan3::dna5 const>, size_t, PackedReadHash, ReadEqual>{};
+    first.reserve(queries.size());
+    auto unique_of = std::vector<size_t>(queries.size());
+    for (size_t id = 0; id < queries.size(); ++id) {
+        auto [it, inserted] = first.try_emplace(queries[id], dedup.unique.size());
+        if (inserted) {
+            dedup.unique.emplace_back(queries[id]);
+        }
+        unique_of[id] = it->second;
+    }
+
+    // group the ids by their distinct query, ids stay in order within a group
+    dedup.offsets.assign(dedup.unique.size() + 1, 0);
+    for (auto u : unique_of) {
+        ++dedup.offsets[u + 1];
+    }
+    for (size_t u = 0; u < dedup.unique.size(); ++u) {
+        dedup.offsets[u + 1] += dedup.offsets[u];
+    }
+    dedup.ids.resize(queries.size());
+    auto next = std::vector<size_t>(dedup.offsets.begin(), dedup.offsets.end() - 1);
+    for (size_t id = 0; id < queries.size(); ++id) {
+        dedup.ids[next[unique_of[id]]++] = id;
+    }
+    return dedup;
+}
+
+// calls `f(id)` with the id of every query that the searched query `id`
+// stands for, without deduplication (nullptr) that is only `id` itself
+template <typename F>
+void for_each_original(QueryDedup const* dedup, size_t id, F&& f) {
+    if (!dedup) {
+        f(id);
+        return;
+    }
+    for (auto original : dedup->originals(id)) {
+        f(original);
+    }
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef QUERY_PIPELINE_HPP
+#define QUERY_PIPELINE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+#include <seqan3/io/sequence_file/all.hpp>
+
+// Blocking queue with a fixed capacity, push waits while the queue is full so
+// a slow consumer throttles its producer.
+template <typename T>
+class BoundedQueue {
+    private:
+        std::mutex mutex;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+        std::deque<T> items;
+        size_t capacity;
+        bool closed = false;
+
+    public:
+        explicit BoundedQueue(size_t capacity) : capacity{capacity} {}
+
+        // returns false if the queue was closed, the item is dropped then
+        bool push(T item) {
+            std::unique_lock lock{mutex};
+            not_full.wait(lock, [&] { return items.size() < capacity || closed; });
+            if (closed) return false;
+            items.push_back(std::move(item));
+            not_empty.notify_one();
+            return true;
+        }
+
+        // waits for the next item, returns std::nullopt once the queue is closed and drained
+        std::optional<T> pop() {
+            std::unique_lock lock{mutex};
+            not_empty.wait(lock, [&] { return !items.empty() || closed; });
+            if (items.empty()) return std::nullopt;
+            auto item = std::move(items.front());
+            items.pop_front();
+            not_full.notify_one();
+            return item;
+        }
+
+        void close() {
+            std::lock_guard lock{mutex};
+            closed = true;
+            not_full.notify_all();
+            not_empty.notify_all();
+        }
+};
+
+// a batch of consecutive queries, the first one has the id `first_id`
+struct QueryBatch {
+    size_t first_id = 0;
+    std::vector<std::vector<seqan3::dna5>> queries;
+};
+
+// the output produced for one batch
+struct OutputBatch {
+    size_t      first_id    = 0;
+    size_t      query_count = 0;
+    std::string text;
+};
+
+struct PipelineOptions {
+    size_t batch_size  = 4096; // queries per batch
+    size_t queue_depth = 4;    // batches that may wait between two stages
+};
+
+// Three stage pipeline over the reads of `query_file`:
+//   parse:  reads batches of queries (on its own thread, this includes the gzip decompression)
+//   search: `search(QueryBatch const&, std::string& out)` on the calling thread
+//   emit:   `emit(OutputBatch const&)` on its own thread, in batch order
+// Only queue_depth batches are buffered between two stages, so the memory
+// footprint does not depend on the number of reads. Like the in-memory
+// duplication the file is read again from the start until `query_count`
+// queries were produced.
+template <typename search_t, typename emit_t>
+void run_query_pipeline(std::filesystem::path const& query_file, size_t query_count,
+                        search_t&& search, emit_t&& emit, PipelineOptions const& options = {}) {
+    auto parsed   = BoundedQueue<QueryBatch>{options.queue_depth};
+    auto searched = BoundedQueue<OutputBatch>{options.queue_depth};
+    auto parse_error = std::exception_ptr{};
+    auto emit_error  = std::exception_ptr{};
+
+    auto parser = std::jthread{[&] {
+        try {
+            auto batch = QueryBatch{};
+            size_t produced = 0;
+            while (produced < query_count) {
+                auto query_stream = seqan3::sequence_file_input{query_file};
+                size_t in_file = 0;
+                for (auto& record : query_stream) {
+                    if (produced == query_count) break;
+                    batch.queries.push_back(record.sequence());
+                    ++produced;
+                    ++in_file;
+                    if (batch.queries.size() == options.batch_size) {
+                        auto next_id = batch.first_id + batch.queries.size();
+                        if (!parsed.push(std::move(batch))) return;
+                        batch = QueryBatch{next_id, {}};
+                    }
+                }
+                if (in_file == 0) break; // empty file, nothing to duplicate
+            }
+            if (!batch.queries.empty()) {
+                parsed.push(std::move(batch));
+            }
+        } catch (...) {
+            parse_error = std::current_exception();
+        }
+        parsed.close();
+    }};
+
+    auto emitter = std::jthread{[&] {
+        try {
+            while (auto batch = searched.pop()) {
+                emit(*batch);
+            }
+        } catch (...) {
+            emit_error = std::current_exception();
+            searched.close();
+        }
+    }};
+
+    try {
+        while (auto batch = parsed.pop()) {
+            auto out = OutputBatch{batch->first_id, batch->queries.size(), {}};
+            search(*batch, out.text);
+            if (!searched.push(std::move(out))) break;
+        }
+    } catch (...) {
+        parsed.close();
+        searched.close();
+        throw;
+    }
+    parsed.close();
+    searched.close();
+    parser.join();
+    emitter.join();
+
+    if (parse_error) std::rethrow_exception(parse_error);
+    if (emit_error)  std::rethrow_exception(emit_error);
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef QUERY_TRIE_HPP
+#define QUERY_TRIE_HPP
+
+#include "fm_native.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+// Trie over the reversed queries of a batch. The path to a node spells a
+// suffix shared by all queries below it, read right to left like backward
+// search reads them.
+struct QueryTrie {
+    static constexpr uint32_t no_query = std::numeric_limits<uint32_t>::max();
+
+    struct Node {
+        std::array<uint32_t, seqan3::alphabet_size<seqan3::dna5>> children{}; // by dna5 rank, 0 for none (the root is nobody's child)
+        uint32_t first_query = no_query;                                        // queries ending here are chained by next_query
+
+        bool is_leaf() const {
+            return std::ranges::all_of(children, [](uint32_t child) { return child == 0; });
+        }
+    };
+
+    std::vector<Node>     nodes;
+    std::vector<uint32_t> next_query;
+
+    // replaces the trie by one over `queries`, the memory is reused
+    template <typename queries_t>
+    void build(queries_t const& queries) {
+        nodes.assign(1, Node{});
+        next_query.assign(std::ranges::size(queries), no_query);
+        uint32_t query_id = 0;
+        for (auto const& query : queries) {
+            uint32_t node = 0;
+            for (auto it = std::ranges::rbegin(query); it != std::ranges::rend(query); ++it) {
+                auto const rank = seqan3::to_rank(*it);
+                if (nodes[node].children[rank] == 0) {
+                    nodes[node].children[rank] = static_cast<uint32_t>(nodes.size());
+                    nodes.emplace_back();
+                }
+                node = nodes[node].children[rank];
+            }
+            next_query[query_id] = nodes[node].first_query;
+            nodes[node].first_query = query_id++;
+        }
+    }
+};
+
+// Searches all queries of `trie` with at most `max_errors` substitutions by
+// one depth first walk over the index. A branch carries every trie node whose
+// suffix is within max_errors of the string the branch spells, so the LF steps
+// of a suffix shared by several queries, and of the backtracking below it, are
+// done once. A branch ends when its interval is empty or no node is left.
+// `report(query_id, interval)` is called for every matching interval, the
+// intervals of a query are distinct.
+template <typename index_t, typename report_t>
+void trie_search(index_t const& index, QueryTrie const& trie, uint8_t max_errors, report_t&& report) {
+    struct Active {
+        uint32_t node;
+        uint8_t  errors;
+    };
+    // the active nodes of all branches on the current path, each branch owns a range
+    auto active = std::vector<Active>{{0, 0}};
+
+    auto report_ends = [&](uint32_t node, NativeInterval iv) {
+        for (auto query_id = trie.nodes[node].first_query; query_id != QueryTrie::no_query; query_id = trie.next_query[query_id]) {
+            report(query_id, iv);
+        }
+    };
+    report_ends(0, full_interval(index));
+
+    auto rec = [&](auto& self, NativeInterval iv, size_t begin, size_t end) -> void {
+        for (uint8_t rank = 0; rank < seqan3::alphabet_size<seqan3::dna5>; ++rank) {
+            // the nodes that stay within max_errors when `rank` is prepended,
+            // the LF step is skipped if there are none
+            auto const next_begin = active.size();
+            for (size_t i = begin; i < end; ++i) {
+                auto const [node, errors] = active[i];
+                for (uint8_t expected = 0; expected < seqan3::alphabet_size<seqan3::dna5>; ++expected) {
+                    auto const child       = trie.nodes[node].children[expected];
+                    auto const next_errors = static_cast<uint8_t>(errors + (expected != rank ? 1 : 0));
+                    if (child != 0 && next_errors <= max_errors) {
+                        active.push_back({child, next_errors});
+                    }
+                }
+            }
+            if (active.size() == next_begin) continue;
+
+            auto next = extend_left(index, iv, rank + 1); // native_symbol of the rank
+            if (!next.empty()) {
+                bool inner = false;
+                for (size_t i = next_begin; i < active.size(); ++i) {
+                    report_ends(active[i].node, next);
+                    inner |= !trie.nodes[active[i].node].is_leaf();
+                }
+                if (inner) {
+                    self(self, next, next_begin, active.size());
+                }
+            }
+            active.resize(next_begin);
+        }
+    };
+    rec(rec, full_interval(index), 0, 1);
+}
+
+#endif
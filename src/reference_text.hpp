@@ -0,0 +1,114 @@
+#ifndef REFERENCE_TEXT_HPP
+#define REFERENCE_TEXT_HPP
+
+#include "mapped_file.hpp"
+#include "packed_sequence.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+#include <seqan3/io/sequence_file/all.hpp>
+
+// The packed references that fmindex_construct --store-text appends to an
+// index file. All values are little endian u64, the section starts 8 byte
+// aligned so the words can be used in place from a mapped file:
+//   "ISTEXT01", number of sequences,
+//   per sequence: length, number of words, number of N runs,
+//   per sequence: its words, then its N runs as (begin, end)
+// The last 8 bytes of the file hold the offset of the section.
+inline constexpr uint64_t reference_text_magic = 0x3130'5458'4554'5349; // "ISTEXT01"
+
+inline void write_reference_text(std::ostream& os, std::span<std::vector<seqan3::dna5> const> reference) {
+    auto write = [&](uint64_t value) {
+        os.write(reinterpret_cast<char const*>(&value), sizeof(value));
+    };
+    auto const end = static_cast<uint64_t>(os.tellp());
+    auto const offset = (end + 7) / 8 * 8;
+    for (auto i = end; i < offset; ++i) {
+        os.put(0);
+    }
+
+    auto packed = std::vector<PackedSequence>{};
+    for (auto const& sequence : reference) {
+        packed.emplace_back(sequence);
+    }
+    write(reference_text_magic);
+    write(packed.size());
+    for (auto const& sequence : packed) {
+        write(sequence.length);
+        write(sequence.words.size());
+        write(sequence.n_runs.size());
+    }
+    for (auto const& sequence : packed) {
+        os.write(reinterpret_cast<char const*>(sequence.words.data()), sequence.words.size() * sizeof(uint64_t));
+        os.write(reinterpret_cast<char const*>(sequence.n_runs.data()), sequence.n_runs.size() * sizeof(NRun));
+    }
+    write(offset);
+}
+
+// The references as packed sequences, either mapped from an index file that
+// stores them or packed from a FASTA file.
+class ReferenceText {
+	private:
+		std::optional<MappedFile>   file;
+		std::vector<PackedSequence> owned;
+		std::vector<PackedView>     views;
+
+	public:
+		static ReferenceText from_fasta(std::filesystem::path const& reference_file) {
+			auto text = ReferenceText{};
+			auto reference_stream = seqan3::sequence_file_input{reference_file};
+			for (auto& record : reference_stream) {
+				text.owned.emplace_back(record.sequence());
+			}
+			for (auto const& sequence : text.owned) {
+				text.views.push_back(sequence.view());
+			}
+			return text;
+		}
+
+		// the index file has to be written with --store-text
+		static ReferenceText from_index(std::filesystem::path const& index_path) {
+			auto text = ReferenceText{};
+			auto const& bytes = text.file.emplace(index_path).bytes();
+			auto invalid = [&] {
+				return std::runtime_error{"index file " + index_path.string() + " has no valid reference text"};
+			};
+
+			// reads `count` u64 at `position`, checking that they are inside the file
+			auto words_at = [&](uint64_t position, uint64_t count) {
+				if (position % 8 != 0 || position > bytes.size() || count > (bytes.size() - position) / 8) throw invalid();
+				return std::span{reinterpret_cast<uint64_t const*>(bytes.data() + position), count};
+			};
+			if (bytes.size() < 8) throw invalid();
+			auto offset = uint64_t{};
+			std::memcpy(&offset, bytes.data() + bytes.size() - 8, sizeof(offset));
+			auto const head = words_at(offset, 2);
+			if (head[0] != reference_text_magic) throw invalid();
+
+			auto const descriptors = words_at(offset + 16, 3 * head[1]);
+			auto position = offset + 16 + descriptors.size_bytes();
+			for (size_t i = 0; i < head[1]; ++i) {
+				auto const length = descriptors[3 * i];
+				auto const words  = words_at(position, descriptors[3 * i + 1]);
+				position += words.size_bytes();
+				auto const runs   = words_at(position, 2 * descriptors[3 * i + 2]);
+				position += runs.size_bytes();
+				if (words.size() < length / 32 + 2) throw invalid();
+				text.views.push_back({length, words, {reinterpret_cast<NRun const*>(runs.data()), runs.size() / 2}});
+			}
+			return text;
+		}
+
+		size_t size() const { return views.size(); }
+		PackedView const& operator[](size_t i) const { return views[i]; }
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "result_sink.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+ResultFormat parse_result_format(std::string_view name, bool quiet) {
+	if (quiet) return ResultFormat::none;
+	if (name == "binary") return ResultFormat::binary;
+	return ResultFormat::sam;
+}
+
+namespace {
+
+void append_number(std::string& out, uint64_t value) {
+	char digits[20];
+	auto result = std::to_chars(digits, digits + sizeof(digits), value);
+	out.append(digits, result.ptr);
+}
+
+template <typename T>
+void append_raw(std::string& out, T value) {
+	// the binary format is little endian, which is what all supported platforms use
+	char bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	out.append(bytes, sizeof(T));
+}
+
+[[noreturn]] void throw_write_error() {
+	throw std::runtime_error{std::string{"could not write the results: "} + std::strerror(errno)};
+}
+
+}
+
+void append_hit(std::string& out, ResultFormat format, Hit const& hit) {
+	switch (format) {
+	case ResultFormat::sam:
+		append_number(out, hit.query_id);
+		out += hit.reverse ? "\t16\t" : "\t0\t";
+		append_number(out, hit.reference_id);
+		out += '\t';
+		append_number(out, hit.position + 1);
+		out += "\t255\t*\t*\t0\t0\t*\t*";
+		if (hit.errors != Hit::unknown_errors) {
+			out += "\tNM:i:";
+			append_number(out, hit.errors);
+		}
+		out += '\n';
+		break;
+	case ResultFormat::binary:
+		if (hit.reference_id > std::numeric_limits<uint32_t>::max()) {
+			throw std::runtime_error{"reference id " + std::to_string(hit.reference_id) + " does not fit into the binary format"};
+		}
+		append_raw(out, hit.query_id);
+		append_raw(out, static_cast<uint32_t>(hit.reference_id));
+		append_raw(out, hit.position);
+		append_raw(out, hit.errors);
+		append_raw(out, static_cast<uint8_t>(hit.reverse));
+		break;
+	case ResultFormat::none:
+		break;
+	}
+}
+
+void append_count(std::string& out, ResultFormat format, uint64_t query_id, uint64_t count) {
+	switch (format) {
+	case ResultFormat::sam:
+		append_number(out, query_id);
+		out += "\t4\t*\t0\t255\t*\t*\t0\t0\t*\t*\tX0:i:";
+		append_number(out, count);
+		out += '\n';
+		break;
+	case ResultFormat::binary:
+		append_raw(out, query_id);
+		append_raw(out, count);
+		break;
+	case ResultFormat::none:
+		break;
+	}
+}
+
+std::string LocateOptions::method_suffix() const {
+	if (count_only) return "_count";
+	if (max_hits > 0) return "_max" + std::to_string(max_hits);
+	return "";
+}
+
+ResultWriter::ResultWriter(std::filesystem::path const& path, ResultFormat format, bool counts) : format{format} {
+	if (path.empty() || path == "-") {
+		file = stdout;
+		owns_file = false;
+	} else {
+		file = std::fopen(path.c_str(), "wb");
+		owns_file = true;
+		if (!file) {
+			throw std::runtime_error{"could not open output file " + path.string()};
+		}
+	}
+	buffer.reserve(buffer_size);
+	if (format == ResultFormat::binary) {
+		buffer += counts ? "ISCNTS01" : "ISHITS02";
+	}
+}
+
+// the searches call flush() at the end, where a failed write throws; here
+// it can only be reported
+ResultWriter::~ResultWriter() {
+	try {
+		flush_buffer();
+		if (std::fflush(file) != 0) throw_write_error();
+	} catch (std::runtime_error const& error) {
+		std::fprintf(stderr, "%s\n", error.what());
+	}
+	if (owns_file) {
+		std::fclose(file);
+	}
+}
+
+void ResultWriter::flush_buffer() {
+	// cleared either way, the destructor does not retry a failed write
+	bool const written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+	buffer.clear();
+	if (!written) throw_write_error();
+}
+
+void ResultWriter::flush() {
+	std::lock_guard lock{mutex};
+	flush_buffer();
+	if (std::fflush(file) != 0) throw_write_error();
+}
+
+void ResultWriter::write(std::string_view formatted_hits) {
+	if (format == ResultFormat::none || formatted_hits.empty()) return;
+
+	std::lock_guard lock{mutex};
+	if (buffer.size() + formatted_hits.size() > buffer_size) {
+		flush_buffer();
+	}
+	if (formatted_hits.size() >= buffer_size) {
+		if (std::fwrite(formatted_hits.data(), 1, formatted_hits.size(), file) != formatted_hits.size()) throw_write_error();
+	} else {
+		buffer.append(formatted_hits);
+	}
+}
@@ -0,0 +1,82 @@
+#ifndef RESULT_SINK_HPP
+#define RESULT_SINK_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// a single occurrence of a query in the reference
+struct Hit {
+    static constexpr uint8_t unknown_errors = 0xff;
+
+    uint64_t query_id;
+    uint64_t reference_id;
+    uint64_t position;     // 0-based
+    uint8_t  errors = unknown_errors;
+    bool     reverse = false; // the reverse complement of the query matched (--both-strands)
+};
+
+enum class ResultFormat {
+    sam,    // SAM-like text: one tab separated line per hit, no header
+    binary, // "ISHITS02" followed by packed little endian records, see append_hit
+    none,   // nothing is written (--quiet)
+};
+
+// names accepted by --format, in the order of ResultFormat
+inline std::vector<std::string> const result_format_names{"sam", "binary"};
+ResultFormat parse_result_format(std::string_view name, bool quiet);
+
+// Formats a hit and appends it to `out`. Every thread or chunk formats into
+// its own buffer, so only ResultWriter::write needs synchronisation.
+//   sam:    <query_id> <0 or 16 for reverse> <reference_id> <position+1> 255 * * 0 0 * * [NM:i:<errors>]
+//   binary: u64 query_id, u32 reference_id, u64 position, u8 errors, u8 flags (23 bytes, flag 1 = reverse)
+// A reference_id beyond 32 bits can not be written in binary and throws.
+void append_hit(std::string& out, ResultFormat format, Hit const& hit);
+
+// Appends the number of occurrences of a query (--count-only) to `out`.
+//   sam:    <query_id> 4 * 0 255 * * 0 0 * * X0:i:<count>
+//   binary: u64 query_id, u64 count (16 bytes)
+void append_count(std::string& out, ResultFormat format, uint64_t query_id, uint64_t count);
+
+// how much of the occurrences of a query is reported
+struct LocateOptions {
+    bool   count_only = false; // only the number of occurrences, nothing is located
+    size_t max_hits   = 0;     // at most this many positions per query, 0 for all
+
+    // appended to the benchmark method so runs without a full locate can be told apart
+    std::string method_suffix() const;
+};
+
+// Writes formatted hits to a file or to stdout ("-") through a large buffer.
+// write() may be called from several threads. write() and flush() throw
+// std::runtime_error if the output can not be written, e.g. on a full disk. Binary files start with
+// "ISHITS02", or with "ISCNTS01" if they hold counts instead of hits.
+class ResultWriter {
+	private:
+		std::mutex mutex;
+		std::FILE* file;
+		bool owns_file;
+		ResultFormat format;
+		std::string buffer;
+
+		void flush_buffer();
+
+	public:
+		static constexpr size_t buffer_size = size_t{1} << 22;
+
+		ResultWriter(std::filesystem::path const& path, ResultFormat format, bool counts = false);
+		~ResultWriter();
+		ResultWriter(ResultWriter const&) = delete;
+		ResultWriter& operator=(ResultWriter const&) = delete;
+
+		ResultFormat get_format() const { return format; }
+		void write(std::string_view formatted_hits);
+		// writes out the buffer, e.g. to time the output on its own
+		void flush();
+};
+
+#endif
@@ -0,0 +1,388 @@
+#include "chunk_scheduler.hpp"
+#include "fm_search.hpp"
+#include "index_file.hpp"
+#include "naive_search.hpp"
+#include "pigeon_search.hpp"
+#include "reference_text.hpp"
+#include "sharded_index.hpp"
+#include "suffixarray_search.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <fmindex-collection/fmindex-collection.h>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+#include <seqan3/argument_parser/all.hpp>
+#include <seqan3/core/debug_stream.hpp>
+#include <seqan3/io/sequence_file/all.hpp>
+
+// engines of --engine:
+//   fm:            fm_search as configured by the index, see visit_index
+//   fm_interleave: exact searches advanced together with prefetching, see batched_search.hpp
+//   fm_trie:       queries searched as a trie, see query_trie.hpp
+//   pigeon:        pieces searched in the index, candidates verified, see pigeon_search.hpp
+//   naive:         a scan of the references per query, see naive_search.hpp
+//   sa:            binary search on a suffix array, see suffixarray_search.hpp
+// fm_interleave and fm_trie need a native unidirectional index, pigeon any
+// index and the references, naive and sa only the references and only
+// search exactly
+inline std::vector<std::string> const engine_names{"fm", "fm_interleave", "fm_trie", "pigeon", "naive", "sa"};
+
+// one configuration of the sweep and the times of its repetitions
+struct BenchResult {
+    std::string         engine;
+    size_t              query_count;
+    size_t              query_length; // 0 for the full queries
+    uint8_t             errors;
+    size_t              hits;         // occurrences, or counted occurrences, per repetition
+    std::vector<double> times_ms;
+};
+
+// median of the repetitions with a distribution free 95% confidence interval
+// from the order statistics around it; with few repetitions it is min to max
+struct BenchSummary {
+    double median;
+    double ci_low;
+    double ci_high;
+    double mean;
+    double min;
+};
+
+BenchSummary summarize(std::vector<double> times) {
+    std::ranges::sort(times);
+    auto const n = times.size();
+    auto summary = BenchSummary{};
+    summary.median = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+    auto const spread = 1.96 * std::sqrt(static_cast<double>(n)) / 2;
+    auto const low    = static_cast<size_t>(std::max(0.0, std::floor(n / 2.0 - spread)));
+    auto const high   = std::min(n - 1, static_cast<size_t>(std::ceil(n / 2.0 + spread)));
+    summary.ci_low  = times[low];
+    summary.ci_high = times[high];
+    summary.mean    = 0;
+    for (auto time : times) {
+        summary.mean += time / n;
+    }
+    summary.min = times.front();
+    return summary;
+}
+
+std::string json_string(std::string const& text) {
+    auto quoted = std::string{"\""};
+    for (auto c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+int main(int argc, char const* const* argv) {
+    seqan3::argument_parser parser{"search_bench", argc, argv, seqan3::update_notifications::off};
+
+    parser.info.author = "SeqAn-Team";
+    parser.info.version = "1.0.0";
+    parser.info.short_description = "loads an index and queries once and times the engines over a sweep of query counts, lengths and errors";
+
+    auto index_path = std::filesystem::path{};
+    parser.add_option(index_path, '\0', "index", "path to the index file, needed by the fm and pigeon engines");
+
+    auto reference_file = std::filesystem::path{};
+    parser.add_option(reference_file, '\0', "reference", "path to the reference file, needed by naive and sa and by pigeon unless the index was built with --store-text");
+
+    auto query_file = std::filesystem::path{};
+    parser.add_option(query_file, '\0', "query", "path to the query file");
+
+    auto engines = std::vector<std::string>{};
+    parser.add_option(engines, '\0', "engine", "engine to run, repeat for several (default fm)",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{engine_names});
+
+    auto query_counts = std::vector<size_t>{};
+    parser.add_option(query_counts, '\0', "query_ct", "number of queries, repeat for a sweep (default 100), queries are duplicated if there are not enough");
+
+    auto query_lengths = std::vector<size_t>{};
+    parser.add_option(query_lengths, '\0', "length", "queries are cut to this length, repeat for a sweep (default 0, the full queries)");
+
+    auto error_counts = std::vector<uint8_t>{};
+    parser.add_option(error_counts, '\0', "errors", "number of allowed errors, repeat for a sweep (default 0); substitutions and indels on seqan3 indices "
+                                                     "and for pigeon with --error-model edit, substitutions only on native indices and for pigeon otherwise");
+
+    auto error_model = std::string{"hamming"};
+    parser.add_option(error_model, '\0', "error-model", "errors of the pigeon engine, hamming (mismatches only) or edit (mismatches and indels)",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{std::vector<std::string>{"hamming", "edit"}});
+
+    auto batch_size = size_t{64};
+    parser.add_option(batch_size, '\0', "batch-size", "number of reads whose pieces the pigeon engine searches together",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1 << 20});
+
+    auto warmup = size_t{1};
+    parser.add_option(warmup, '\0', "warmup", "untimed runs of every configuration before its repetitions");
+
+    auto repetitions = size_t{5};
+    parser.add_option(repetitions, '\0', "repetitions", "timed runs of every configuration",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1'000'000});
+
+    auto options = SearchOptions{};
+    options.interleave = 32;
+    parser.add_option(options.interleave, '\0', "interleave", "number of searches the fm_interleave engine advances together",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{2, 1024});
+    parser.add_option(options.threads, '\0', "threads", "number of threads used for searching",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 1024});
+    parser.add_flag(options.locate.count_only, '\0', "count-only", "only count the occurrences, nothing is located");
+
+    auto json_file = std::filesystem::path{"search_bench.json"};
+    parser.add_option(json_file, '\0', "json", "file the results are written to as JSON");
+
+    auto csv_file = std::filesystem::path{"search_bench.csv"};
+    parser.add_option(csv_file, '\0', "csv", "file the results are appended to as CSV");
+
+    try {
+         parser.parse();
+    } catch (seqan3::argument_parser_error const& ext) {
+        seqan3::debug_stream << "Parsing error. " << ext.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    if (engines.empty())       engines       = {"fm"};
+    if (query_counts.empty())  query_counts  = {100};
+    if (query_lengths.empty()) query_lengths = {0};
+    if (error_counts.empty())  error_counts  = {0};
+    auto uses = [&](std::string const& engine) {
+        return std::ranges::find(engines, engine) != engines.end();
+    };
+    bool const uses_index = uses("fm") || uses("fm_interleave") || uses("fm_trie") || uses("pigeon");
+    if (uses_index && index_path.empty()) {
+        seqan3::debug_stream << "the fm and pigeon engines need --index\n";
+        return EXIT_FAILURE;
+    }
+    if (uses_index && is_sharded_index(index_path)) {
+        seqan3::debug_stream << "search_bench does not support sharded indices\n";
+        return EXIT_FAILURE;
+    }
+    if ((uses("naive") || uses("sa")) && reference_file.empty()) {
+        seqan3::debug_stream << "the naive and sa engines need --reference\n";
+        return EXIT_FAILURE;
+    }
+    if (uses("pigeon") && reference_file.empty() && !read_index_header(index_path).stored_text) {
+        seqan3::debug_stream << "the pigeon engine needs --reference unless the index was built with --store-text\n";
+        return EXIT_FAILURE;
+    }
+
+    // the queries are read once, every configuration takes spans of them
+    std::vector<std::vector<seqan3::dna5>> queries;
+    auto query_stream = seqan3::sequence_file_input{query_file};
+    for (auto& record : query_stream) {
+        queries.push_back(record.sequence());
+    }
+    if (queries.empty()) {
+        seqan3::debug_stream << "no queries in " << query_file << "\n";
+        return EXIT_FAILURE;
+    }
+    auto select_queries = [&](size_t count, size_t length) {
+        auto selected = std::vector<std::span<seqan3::dna5 const>>{};
+        selected.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            auto const& query = queries[i % queries.size()];
+            selected.emplace_back(query.data(), length ? std::min(length, query.size()) : query.size());
+        }
+        return selected;
+    };
+
+    // times `run(queries, errors)`, which returns the number of hits, for
+    // every configuration of the sweep; engines that allow fewer than
+    // `max_errors` skip the other configurations
+    auto results = std::vector<BenchResult>{};
+    auto sweep = [&](std::string const& engine, uint8_t max_errors, auto&& run) {
+        for (auto count : query_counts) {
+            for (auto length : query_lengths) {
+                auto const selected = select_queries(count, length);
+                for (auto errors : error_counts) {
+                    if (errors > max_errors) {
+                        seqan3::debug_stream << "skipping " << engine << " with errors=" << int{errors} << ", it only searches exactly\n";
+                        continue;
+                    }
+                    auto& result = results.emplace_back(BenchResult{engine, count, length, errors, 0, {}});
+                    for (size_t i = 0; i < warmup; ++i) {
+                        result.hits = run(selected, errors);
+                    }
+                    for (size_t i = 0; i < repetitions; ++i) {
+                        auto start = std::chrono::steady_clock::now();
+                        result.hits = run(selected, errors);
+                        result.times_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                    }
+                    auto const summary = summarize(result.times_ms);
+                    seqan3::debug_stream << engine << " queries=" << count << " length=" << length << " errors=" << int{errors}
+                                         << ": " << summary.median << "ms [" << summary.ci_low << ", " << summary.ci_high << "]\n";
+                }
+            }
+        }
+    };
+    constexpr uint8_t any_errors = std::numeric_limits<uint8_t>::max();
+
+    // the references of naive and sa, read once; sa searches them concatenated
+    std::vector<std::vector<seqan3::dna5>> reference;
+    if (uses("naive") || uses("sa")) {
+        auto reference_stream = seqan3::sequence_file_input{reference_file};
+        for (auto& record : reference_stream) {
+            reference.push_back(record.sequence());
+        }
+    }
+
+    if (uses("naive")) {
+        sweep("naive", 0, [&](auto const& selected, uint8_t) {
+            size_t hits = 0;
+            for (auto const& query : selected) {
+                for (auto const& sequence : reference) {
+                    if (sequence.size() < query.size()) continue;
+                    findOccurences(sequence, query, [&](size_t) {
+                        ++hits;
+                        return true;
+                    });
+                }
+            }
+            return hits;
+        });
+    }
+
+    if (uses("sa")) {
+        auto combined = std::vector<seqan3::dna5>{};
+        auto reference_starts = std::vector<size_t>{};
+        for (auto const& sequence : reference) {
+            reference_starts.push_back(combined.size());
+            combined.insert(combined.end(), sequence.begin(), sequence.end());
+        }
+        auto const suffixarray = fmindex_collection::createSA64(std::span{reinterpret_cast<uint8_t const*>(combined.data()), combined.size()}, 1);
+        auto located = std::vector<Hit>{};
+        sweep("sa", 0, [&](auto const& selected, uint8_t) {
+            size_t hits = 0;
+            for (size_t query_id = 0; query_id < selected.size(); ++query_id) {
+                auto const& query = selected[query_id];
+                auto const [first, last] = naive_binary_search(&query, &combined, &suffixarray);
+                if (first < 0) continue;
+                if (options.locate.count_only && reference_starts.size() == 1) {
+                    hits += last - first + 1;
+                    continue;
+                }
+                // like suffixarray_search, every position is mapped back to its
+                // sequence and a match that runs into the next one is skipped
+                located.clear();
+                for (auto i = first; i <= last; ++i) {
+                    auto const position      = suffixarray[i];
+                    auto const reference_id  = std::ranges::upper_bound(reference_starts, position) - reference_starts.begin() - 1;
+                    auto const reference_end = static_cast<size_t>(reference_id) + 1 < reference_starts.size() ? reference_starts[reference_id + 1] : combined.size();
+                    if (position + query.size() > reference_end) continue;
+                    if (options.locate.count_only) {
+                        ++hits;
+                        continue;
+                    }
+                    located.push_back({query_id, static_cast<size_t>(reference_id), position - reference_starts[reference_id], 0, false});
+                }
+                hits += located.size();
+            }
+            return hits;
+        });
+    }
+    reference.clear();
+
+    // pigeon verifies its candidates against the packed references
+    auto pigeon_reference = std::optional<ReferenceText>{};
+    if (uses("pigeon")) {
+        pigeon_reference.emplace(reference_file.empty() ? ReferenceText::from_index(index_path)
+                                                        : ReferenceText::from_fasta(reference_file));
+    }
+    if (uses_index) visit_index(index_path, [&]<typename index_t>(index_t const& index, IndexExtras const& extras) {
+        constexpr bool native_unidirectional = is_native_index<index_t> && !is_native_bi_index<index_t>;
+
+        for (auto const& engine : engines) {
+            if (engine == "naive" || engine == "sa") continue;
+            if ((engine == "fm_interleave" || engine == "fm_trie") && !native_unidirectional) {
+                seqan3::debug_stream << "skipping " << engine << ", it needs a native unidirectional index\n";
+                continue;
+            }
+            if (engine == "fm_interleave" && !index_can_prefetch<index_t>) {
+                seqan3::debug_stream << "skipping " << engine << ", the occurrence table of the index cannot prefetch\n";
+                continue;
+            }
+
+            if (engine == "pigeon") {
+                // the batches are distributed by the chunk scheduler like in fmindex_pigeon_search
+                auto const pigeon = PigeonOptions{.edit = error_model == "edit"};
+                auto arenas = std::vector<PigeonArena>(options.threads);
+                auto thread_hits = std::vector<size_t>(options.threads);
+                sweep(engine, any_errors, [&](auto const& selected, uint8_t errors) {
+                    auto pigeon_errors = pigeon;
+                    pigeon_errors.errors = errors;
+                    std::ranges::fill(thread_hits, 0);
+                    parallel_chunks(selected.size(), batch_size, options.threads, [&](size_t thread_id, size_t begin, size_t end) {
+                        pigeon_search(index, extras, *pigeon_reference, std::span{selected}.subspan(begin, end - begin), begin, pigeon_errors, options,
+                                      arenas[thread_id], [&](Hit const&) {
+                            ++thread_hits[thread_id];
+                        }, [&](size_t, size_t count) {
+                            thread_hits[thread_id] += count;
+                        });
+                    });
+                    return std::accumulate(thread_hits.begin(), thread_hits.end(), size_t{0});
+                });
+                continue;
+            }
+
+            auto engine_options = options;
+            engine_options.interleave = engine == "fm_interleave" ? options.interleave : 1;
+            engine_options.trie       = engine == "fm_trie";
+            sweep(engine, any_errors, [&](auto const& selected, uint8_t errors) {
+                size_t hits = 0;
+                if (engine_options.locate.count_only) {
+                    fm_count(index, selected, errors, [&](size_t, size_t occurrences) {
+                        hits += occurrences;
+                    }, extras, engine_options);
+                } else {
+                    fm_search(index, selected, errors, [&](size_t, size_t, size_t) {
+                        ++hits;
+                    }, extras, engine_options);
+                }
+                return hits;
+            });
+        }
+    });
+
+    // CSV: one row per configuration, appended like cpp_benchmark.csv
+    std::ifstream csv_in{csv_file};
+    bool const csv_empty = csv_in.peek() == std::ifstream::traits_type::eof();
+    std::ofstream csv_out{csv_file, std::ios_base::app};
+    if (csv_empty) {
+        csv_out << "engine,index_file,reads_file,threads,query_count,query_length,number_of_errors,repetitions,hits,median_ms,ci_low_ms,ci_high_ms,mean_ms,min_ms\n";
+    }
+    for (auto const& result : results) {
+        auto const summary = summarize(result.times_ms);
+        csv_out << result.engine << "," << index_path << "," << query_file << "," << options.threads << ","
+                << result.query_count << "," << result.query_length << "," << int{result.errors} << "," << repetitions << "," << result.hits << ","
+                << summary.median << "," << summary.ci_low << "," << summary.ci_high << "," << summary.mean << "," << summary.min << "\n";
+    }
+
+    // JSON: the whole run with the times of every repetition
+    std::ofstream json_out{json_file};
+    json_out << "{\n  \"index_file\": " << json_string(index_path.string()) << ",\n  \"reads_file\": " << json_string(query_file.string())
+             << ",\n  \"threads\": " << options.threads << ",\n  \"count_only\": " << (options.locate.count_only ? "true" : "false")
+             << ",\n  \"warmup\": " << warmup << ",\n  \"repetitions\": " << repetitions << ",\n  \"results\": [";
+    for (size_t r = 0; r < results.size(); ++r) {
+        auto const& result  = results[r];
+        auto const  summary = summarize(result.times_ms);
+        json_out << (r ? ",\n" : "\n") << "    {\"engine\": " << json_string(result.engine) << ", \"query_count\": " << result.query_count
+                 << ", \"query_length\": " << result.query_length << ", \"errors\": " << int{result.errors} << ", \"hits\": " << result.hits
+                 << ", \"median_ms\": " << summary.median << ", \"ci_low_ms\": " << summary.ci_low << ", \"ci_high_ms\": " << summary.ci_high
+                 << ", \"mean_ms\": " << summary.mean << ", \"min_ms\": " << summary.min << ", \"times_ms\": [";
+        for (size_t i = 0; i < result.times_ms.size(); ++i) {
+            json_out << (i ? ", " : "") << result.times_ms[i];
+        }
+        json_out << "]}";
+    }
+    json_out << "\n  ]\n}\n";
+
+    return 0;
+}
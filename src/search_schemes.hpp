@@ -0,0 +1,74 @@
+#ifndef SEARCH_SCHEMES_HPP
+#define SEARCH_SCHEMES_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A search of a search scheme (Kucherov et al. 2016). The query is split into
+// pi.size() pieces, `pi` is the order in which the pieces are searched and
+// `l`/`u` are the lower/upper bounds for the accumulated number of errors after
+// each piece. All pieces are numbered from 0.
+struct SearchScheme {
+    std::vector<uint8_t> pi;
+    std::vector<uint8_t> l;
+    std::vector<uint8_t> u;
+};
+
+// Schemes for up to 3 errors with up to k+2 pieces (as for 01*0 seeds), found by an
+// exhaustive search over disjoint covers of all error distributions that
+// minimizes the expected number of backtracking nodes. Every search starts
+// with an exact piece and each occurrence is found by exactly one search.
+//
+// For more errors a plain pigeonhole scheme is used, its searches overlap and
+// may report an occurrence more than once.
+inline std::vector<SearchScheme> optimum_search_scheme(uint8_t max_errors) {
+    switch (max_errors) {
+    case 0:
+        return {{{0}, {0}, {0}}};
+    case 1:
+        return {{{0, 1}, {0, 0}, {0, 1}},
+                {{1, 0}, {0, 1}, {0, 1}}};
+    case 2:
+        return {{{0, 1, 2, 3}, {0, 0, 0, 0}, {0, 0, 2, 2}},
+                {{2, 1, 0, 3}, {0, 0, 1, 1}, {0, 1, 1, 2}},
+                {{3, 2, 1, 0}, {0, 0, 0, 2}, {0, 1, 2, 2}}};
+    case 3:
+        return {{{0, 1, 2, 3, 4}, {0, 0, 0, 0, 0}, {0, 0, 3, 3, 3}},
+                {{2, 1, 0, 3, 4}, {0, 0, 1, 1, 1}, {0, 1, 1, 3, 3}},
+                {{3, 2, 1, 0, 4}, {0, 0, 0, 2, 2}, {0, 1, 2, 2, 3}},
+                {{4, 3, 2, 1, 0}, {0, 0, 0, 0, 3}, {0, 1, 2, 3, 3}}};
+    }
+
+    auto const parts = size_t{max_errors} + 1;
+    auto schemes = std::vector<SearchScheme>{};
+    for (size_t start = 0; start < parts; ++start) {
+        auto s = SearchScheme{};
+        for (size_t i = start; i < parts; ++i) s.pi.push_back(i);
+        for (size_t i = start; i > 0; --i) s.pi.push_back(i - 1);
+        s.l.assign(parts, 0);
+        s.u.assign(parts, max_errors);
+        s.u[0] = 0;
+        schemes.push_back(std::move(s));
+    }
+    return schemes;
+}
+
+// first position of piece `i` when splitting a query of length `length` into
+// `parts` pieces, the remainder is spread over the first pieces; i == parts
+// gives the end of the last piece
+inline size_t piece_start(size_t length, size_t parts, size_t i) {
+    return i * (length / parts) + std::min(i, length % parts);
+}
+
+// piece_start of all pieces and the end of the last one
+inline std::vector<size_t> piece_starts(size_t length, size_t parts) {
+    auto starts = std::vector<size_t>(parts + 1);
+    for (size_t i = 0; i <= parts; ++i) {
+        starts[i] = piece_start(length, parts, i);
+    }
+    return starts;
+}
+
+#endif
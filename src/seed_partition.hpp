@@ -0,0 +1,87 @@
+#ifndef SEED_PARTITION_HPP
+#define SEED_PARTITION_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "search_schemes.hpp"
+
+// Adaptive partitioning of a read into the pieces of the pigeonhole search.
+// Every inner boundary of the equal split (see piece_start) may move by up
+// to two fifths of a piece in steps of a fifth, so neighbouring boundaries
+// never cross. The pieces of all combinations are counted with the index
+// before anything is located and the partition with the fewest occurrences
+// in total is chosen, so a piece that would end in a repeat is moved out
+// of it where possible.
+inline constexpr size_t partition_options = 5; // positions tried per inner boundary
+
+inline size_t boundary_options(size_t parts, size_t i) {
+    return i == 0 || i == parts ? 1 : partition_options;
+}
+
+// position of option `j` of boundary `i`, option 2 is the equal split; the
+// first and last boundary are fixed
+inline size_t boundary_position(size_t length, size_t parts, size_t i, size_t j) {
+    if (i == 0 || i == parts) return piece_start(length, parts, i);
+    auto const step = length / parts / 5; // 0 for pieces shorter than 5, they are not moved
+    return piece_start(length, parts, i) + j * step - 2 * step;
+}
+
+// calls `f(begin, end)` for every piece of every partition that is considered,
+// the counts of the pieces have to be passed to choose_partition in this order
+template <typename F>
+void for_each_partition_piece(size_t length, size_t parts, F&& f) {
+    for (size_t i = 0; i < parts; ++i) {
+        for (size_t a = 0; a < boundary_options(parts, i); ++a) {
+            for (size_t b = 0; b < boundary_options(parts, i + 1); ++b) {
+                f(boundary_position(length, parts, i, a), boundary_position(length, parts, i + 1, b));
+            }
+        }
+    }
+}
+
+// number of pieces for_each_partition_piece enumerates
+inline size_t partition_piece_count(size_t length, size_t parts) {
+    size_t count = 0;
+    for_each_partition_piece(length, parts, [&](size_t, size_t) { ++count; });
+    return count;
+}
+
+// Chooses the partition whose pieces have the smallest sum of `counts` by
+// dynamic programming over the boundaries and writes its parts + 1
+// boundaries to `boundaries`. `choices` is scratch memory.
+inline void choose_partition(size_t length, size_t parts, std::span<size_t const> counts,
+                             std::vector<size_t>& boundaries, std::vector<std::array<uint8_t, partition_options>>& choices) {
+    // cost of the cheapest pieces up to each option of the current boundary
+    auto cost = std::array<size_t, partition_options>{};
+    choices.resize(parts + 1);
+    size_t next = 0;
+    for (size_t i = 0; i < parts; ++i) {
+        auto next_cost = std::array<size_t, partition_options>{};
+        next_cost.fill(std::numeric_limits<size_t>::max());
+        for (size_t a = 0; a < boundary_options(parts, i); ++a) {
+            for (size_t b = 0; b < boundary_options(parts, i + 1); ++b) {
+                auto const total = cost[a] + counts[next++];
+                if (total < next_cost[b]) {
+                    next_cost[b]      = total;
+                    choices[i + 1][b] = static_cast<uint8_t>(a);
+                }
+            }
+        }
+        cost = next_cost;
+    }
+
+    boundaries.resize(parts + 1);
+    size_t option = 0; // the last boundary has a single option
+    for (size_t i = parts; i > 0; --i) {
+        boundaries[i] = boundary_position(length, parts, i, option);
+        option = choices[i][option];
+    }
+    boundaries[0] = 0;
+}
+
+#endif
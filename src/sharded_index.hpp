@@ -0,0 +1,192 @@
+#ifndef SHARDED_INDEX_HPP
+#define SHARDED_INDEX_HPP
+
+#include "fm_search.hpp"
+#include "index_file.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+
+// one index file of a sharded index, it holds the references
+// [first_reference, first_reference + reference_count) of the whole collection
+struct ShardInfo {
+    std::string file;                // relative to the directory of the manifest
+    uint64_t    first_reference = 0;
+    uint64_t    reference_count = 0;
+    uint64_t    length          = 0; // number of bases
+
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        ar(file, first_reference, reference_count, length);
+    }
+};
+
+// A sharded index is this manifest, stored at the index path, plus one index
+// file per shard. Every shard is a complete index as written by
+// fmindex_construct, its reference ids are local and mapped back through
+// first_reference.
+struct ShardManifest {
+    static constexpr uint64_t magic           = shard_manifest_magic;
+    static constexpr uint32_t current_version = 1;
+
+    uint32_t               version = current_version;
+    std::vector<ShardInfo> shards;
+
+    template <typename Archive>
+    void serialize(Archive& ar) {
+        ar(version, shards);
+    }
+
+    uint64_t reference_count() const {
+        return shards.empty() ? 0 : shards.back().first_reference + shards.back().reference_count;
+    }
+};
+
+inline bool is_sharded_index(std::filesystem::path const& index_path) {
+    std::ifstream is{index_path, std::ios::binary};
+    auto magic = uint64_t{};
+    is.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    return is && magic == ShardManifest::magic;
+}
+
+inline ShardManifest read_manifest(std::filesystem::path const& index_path) {
+    std::ifstream is{index_path, std::ios::binary};
+    auto magic = uint64_t{};
+    is.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    if (!is || magic != ShardManifest::magic) {
+        throw std::runtime_error{index_path.string() + " is not a sharded index"};
+    }
+    auto manifest = ShardManifest{};
+    cereal::BinaryInputArchive iarchive{is};
+    iarchive(manifest);
+    if (manifest.version > ShardManifest::current_version) {
+        throw std::runtime_error{"shard manifest was written by a newer version of fmindex_construct"};
+    }
+    return manifest;
+}
+
+inline void write_manifest(std::filesystem::path const& index_path, ShardManifest const& manifest) {
+    std::ofstream os{index_path, std::ios::binary};
+    os.write(reinterpret_cast<char const*>(&ShardManifest::magic), sizeof(ShardManifest::magic));
+    cereal::BinaryOutputArchive oarchive{os};
+    oarchive(manifest);
+}
+
+// file name of the shard `shard_id` of the index at `index_path`
+inline std::string shard_file_name(std::filesystem::path const& index_path, size_t shard_id) {
+    return index_path.filename().string() + ".shard" + std::to_string(shard_id);
+}
+
+inline std::filesystem::path shard_path(std::filesystem::path const& index_path, ShardInfo const& shard) {
+    return index_path.parent_path() / shard.file;
+}
+
+// Loads the shards of a sharded index and calls `f(shard, index, extras)` for
+// each of them. At most `parallel_shards` shards are loaded at the same time,
+// each on its own thread, so the memory needed is bounded by the largest
+// shards rather than the whole collection. `f` may be called concurrently.
+template <typename F>
+void visit_shards(std::filesystem::path const& index_path, ShardManifest const& manifest, size_t parallel_shards, F&& f) {
+    auto next_shard = std::atomic<size_t>{0};
+    auto error      = std::exception_ptr{};
+    auto error_mutex = std::mutex{};
+
+    auto worker = [&] {
+        try {
+            for (size_t i = next_shard++; i < manifest.shards.size(); i = next_shard++) {
+                auto const& shard = manifest.shards[i];
+                visit_index(shard_path(index_path, shard), [&](auto const& index, IndexExtras const& extras) {
+                    f(shard, index, extras);
+                });
+            }
+        } catch (...) {
+            std::lock_guard lock{error_mutex};
+            if (!error) error = std::current_exception();
+            next_shard = manifest.shards.size(); // stop the other workers early
+        }
+    };
+
+    auto threads = std::vector<std::jthread>{};
+    for (size_t i = 1; i < std::min(std::max<size_t>(parallel_shards, 1), manifest.shards.size()); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    threads.clear();
+
+    if (error) std::rethrow_exception(error);
+}
+
+// fm_search over all shards, `report(query_id, reference_id, position)` gets
+// the global reference ids and is called shard by shard in the order of the
+// manifest, within a shard in order of (query, reference, position), never
+// concurrently. A shard is reported as soon as it and all shards before it
+// were searched, so only the hits of shards that finished early are kept.
+// options.locate.max_hits applies to the hits of a query over all shards.
+template <typename queries_t, typename report_t>
+void sharded_search(std::filesystem::path const& index_path, ShardManifest const& manifest, size_t parallel_shards,
+                    queries_t const& queries, uint8_t max_errors, report_t&& report, SearchOptions const& options = {}) {
+    using hit_t = std::tuple<size_t, size_t, size_t>;
+    auto pending     = std::vector<std::vector<hit_t>>(manifest.shards.size());
+    auto searched    = std::vector<bool>(manifest.shards.size());
+    auto reported    = std::vector<size_t>(std::ranges::size(queries));
+    size_t next_shard = 0;
+    auto mutex = std::mutex{};
+    visit_shards(index_path, manifest, parallel_shards, [&](ShardInfo const& shard, auto const& index, IndexExtras const& extras) {
+        auto shard_hits = std::vector<hit_t>{};
+        fm_search(index, queries, max_errors, [&](size_t query_id, size_t reference_id, size_t position) {
+            shard_hits.emplace_back(query_id, shard.first_reference + reference_id, position);
+        }, extras, options);
+        std::ranges::sort(shard_hits);
+
+        std::lock_guard lock{mutex};
+        auto const shard_id = static_cast<size_t>(&shard - manifest.shards.data());
+        pending[shard_id]  = std::move(shard_hits);
+        searched[shard_id] = true;
+        for (; next_shard < manifest.shards.size() && searched[next_shard]; ++next_shard) {
+            for (auto [query_id, reference_id, position] : pending[next_shard]) {
+                if (options.locate.max_hits > 0 && reported[query_id] == options.locate.max_hits) continue;
+                report(query_id, reference_id, position);
+                ++reported[query_id];
+            }
+            pending[next_shard] = {};
+        }
+    });
+}
+
+// fm_count over all shards, `report(query_id, count)` is called once per query, in order
+template <typename queries_t, typename report_t>
+void sharded_count(std::filesystem::path const& index_path, ShardManifest const& manifest, size_t parallel_shards,
+                   queries_t const& queries, uint8_t max_errors, report_t&& report, SearchOptions const& options = {}) {
+    auto counts = std::vector<size_t>(std::ranges::size(queries));
+    auto mutex  = std::mutex{};
+    visit_shards(index_path, manifest, parallel_shards, [&](ShardInfo const&, auto const& index, IndexExtras const& extras) {
+        auto shard_counts = std::vector<size_t>(counts.size());
+        fm_count(index, queries, max_errors, [&](size_t query_id, size_t count) {
+            shard_counts[query_id] = count;
+        }, extras, options);
+
+        std::lock_guard lock{mutex};
+        for (size_t query_id = 0; query_id < counts.size(); ++query_id) {
+            counts[query_id] += shard_counts[query_id];
+        }
+    });
+    for (size_t query_id = 0; query_id < counts.size(); ++query_id) {
+        report(query_id, counts[query_id]);
+    }
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef STRANDS_HPP
+#define STRANDS_HPP
+
+#include <cstddef>
+#include <ranges>
+#include <span>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+
+// writes the reverse complement of `sequence` to `out`, reusing its memory
+inline void reverse_complement(std::span<seqan3::dna5 const> sequence, std::vector<seqan3::dna5>& out) {
+    out.resize(sequence.size());
+    for (size_t i = 0; i < sequence.size(); ++i) {
+        out[i] = sequence[sequence.size() - 1 - i].complement();
+    }
+}
+
+// Queries for a search of both strands (--both-strands): query i becomes
+// query 2i and its reverse complement query 2i + 1, so both strands go through
+// one batched search and share its interleaving, k-mer table lookups and
+// threads. The spans point into `queries` and `reverse`, which holds the
+// reverse complements.
+template <typename queries_t>
+std::vector<std::span<seqan3::dna5 const>> both_strands(queries_t const& queries, std::vector<std::vector<seqan3::dna5>>& reverse) {
+    reverse.resize(std::ranges::size(queries));
+    auto strands = std::vector<std::span<seqan3::dna5 const>>{};
+    strands.reserve(2 * reverse.size());
+    size_t i = 0;
+    for (auto const& query : queries) {
+        reverse_complement(query, reverse[i]);
+        strands.emplace_back(query);
+        strands.emplace_back(reverse[i]);
+        ++i;
+    }
+    return strands;
+}
+
+// id of the original query and strand of a query of both_strands
+inline size_t strand_query_id(size_t id) { return id / 2; }
+inline bool   is_reverse_strand(size_t id) { return id % 2 == 1; }
+
+#endif
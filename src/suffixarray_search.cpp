@@ -1,7 +1,15 @@
 #include "benchmark.hpp"
+#include "query_dedup.hpp"
+#include "query_pipeline.hpp"
+#include "result_sink.hpp"
+#include "strands.hpp"
+#include "suffixarray_search.hpp"
 
 #include <fmindex-collection/fmindex-collection.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <limits>
 #include <tuple>
 #include <sstream>
 #include <span>
@@ -14,43 +22,7 @@
 #include <seqan3/search/fm_index/fm_index.hpp>
 #include <seqan3/search/search.hpp>
 #include <seqan3/alphabet/views/char_to.hpp>
-
-std::tuple<int, int> naive_binary_search(std::vector<seqan3::dna5>* query, std::vector<seqan3::dna5>* reference, std::vector<long unsigned int>* sa) {
-	unsigned long int min_index = 0;
-	unsigned long int max_index = sa->size();
-
-	while (min_index < max_index) {
-		auto c = (min_index + max_index)/2;
-		auto ref_view = *reference | std::views::drop(sa->at(c)) | std::views::take(query->size()) | seqan3::views::to_char;
-		auto query_view = *query | seqan3::views::to_char;
-		if (std::ranges::lexicographical_compare(ref_view, query_view)) {
-			min_index = c + 1;
-		} else {
-			max_index = c;
-		}
-	}
-
-	auto first = min_index;
-	max_index = sa->size();
-
-	while (min_index < max_index) {
-		auto c = (min_index + max_index)/2;
-		auto ref_view = *reference | std::views::drop(sa->at(c)) | std::views::take(query->size()) | seqan3::views::to_char;
-		auto query_view = *query | seqan3::views::to_char;
-
-		if (std::ranges::lexicographical_compare(query_view, ref_view)) {
-			max_index = c;
-		} else {
-			min_index = c + 1;
-		}
-	}
-	auto last = max_index-1;
-	if ((first > last) || !(std::equal(reference->begin()+sa->at(first), reference->begin()+sa->at(first)+query->size(), query->begin()))) {
-		return std::make_tuple(-1, -1);
-	}
-
-	return std::make_tuple(first, last);
-}
+#include <seqan3/alphabet/views/to_char.hpp>
 
 int main(int argc, char const* const* argv) {
     seqan3::argument_parser parser{"suffixarray_search", argc, argv, seqan3::update_notifications::off};
@@ -70,27 +42,137 @@ int main(int argc, char const* const* argv) {
     auto quiet = false;
     parser.add_option(quiet, '\0', "quiet", "do not print matches");
 
+    auto output_file = std::filesystem::path{"-"};
+    parser.add_option(output_file, '\0', "output", "file the matches are written to, - for stdout");
+
+    auto format_name = std::string{"sam"};
+    parser.add_option(format_name, '\0', "format", "output format of the matches, sam or binary",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{result_format_names});
+
+    auto locate = LocateOptions{};
+    parser.add_flag(locate.count_only, '\0', "count-only", "only report the number of occurrences per query, nothing is located");
+    parser.add_option(locate.max_hits, '\0', "max-hits", "locate at most this many occurrences per query, 0 locates all");
+
+    auto both = false;
+    parser.add_flag(both, '\0', "both-strands", "also search the reverse complement of every query, --max-hits applies to each strand");
+
+    auto stream = false;
+    parser.add_flag(stream, '\0', "stream", "search while reading the queries instead of loading all of them first");
+
+    auto use_dedup = false;
+    parser.add_flag(use_dedup, '\0', "dedup", "search every distinct query once and report its results for all queries with the same sequence (not with --stream)");
+
     try {
          parser.parse();
     } catch (seqan3::argument_parser_error const& ext) {
         seqan3::debug_stream << "Parsing error. " << ext.what() << "\n";
         return EXIT_FAILURE;
     }
+    if (use_dedup && stream) {
+        seqan3::debug_stream << "--dedup needs all queries in memory and does not support --stream\n";
+        return EXIT_FAILURE;
+    }
 
-    // loading our files
+    // loading our files, the phases of the run are written to cpp_benchmark_phases.csv
+    auto load_benchmark = Benchmark("sa_load", reference_file, query_file, 0);
     auto reference_stream = seqan3::sequence_file_input{reference_file};
-    auto query_stream     = seqan3::sequence_file_input{query_file};
 
     // read reference into memory
     // Attention: we are concatenating all sequences into one big combined sequence
     //            this is done to simplify the implementation of suffix_arrays
     std::vector<seqan3::dna5> reference;
+    std::vector<size_t> reference_starts; // position of each sequence inside the combined sequence
     for (auto& record : reference_stream) {
         auto r = record.sequence();
+        reference_starts.push_back(reference.size());
         reference.insert(reference.end(), r.begin(), r.end());
     }
 
+    load_benchmark.phase("load_reference");
+
+    auto construct_benchmark = Benchmark("sa_construct", reference_file, "", 0);
+    auto suffixarray = fmindex_collection::createSA64(std::span{reinterpret_cast<uint8_t const*>(reference.data()), reference.size()}, 1);
+    construct_benchmark.write(0);
+    construct_benchmark.phase("build_index");
+
+    auto writer = ResultWriter{output_file, parse_result_format(format_name, quiet), locate.count_only};
+    auto const format = writer.get_format();
+
+    auto const method_suffix = (both ? "_both_strands" : "") + locate.method_suffix();
+
+    // with --dedup the results of a distinct query are reported for all of its copies
+    QueryDedup const* fan_out = nullptr;
+
+    // formats the hits of one strand of a query into `out` and returns their number
+    auto search_strand = [&](std::span<seqan3::dna5 const> q, size_t query_id, bool reverse, std::string& out) -> size_t {
+        //!TODO !ImplementMe apply binary search and find q  in reference using binary search on `suffixarray`
+        // You can choose if you want to use binary search based on "naive approach", "mlr-trick", "lcp"
+	auto results = naive_binary_search(&q, &reference, &suffixarray);
+	if (std::get<0>(results) < 0) return 0;
+	auto [first, last] = results;
+	if (locate.count_only && reference_starts.size() == 1) {
+		// the size of the interval is the count, no need to look at the suffix array
+		return last - first + 1;
+	}
+	// the references are concatenated without a separator, a match that runs
+	// from one reference into the next is no occurrence and skipped
+	auto const max_hits = locate.max_hits > 0 && !locate.count_only ? locate.max_hits : std::numeric_limits<size_t>::max();
+	size_t count = 0;
+	for (auto i = first; i <= last && count < max_hits; i++) {
+		// map the position in the combined sequence back to its sequence
+		auto position = suffixarray[i];
+		auto reference_id = std::upper_bound(reference_starts.begin(), reference_starts.end(), position) - reference_starts.begin() - 1;
+		auto reference_end = static_cast<size_t>(reference_id) + 1 < reference_starts.size() ? reference_starts[reference_id + 1] : reference.size();
+		if (position + q.size() > reference_end) continue;
+		++count;
+		if (locate.count_only || format == ResultFormat::none) continue;
+		for_each_original(fan_out, query_id, [&](size_t id) {
+			append_hit(out, format, {id, static_cast<size_t>(reference_id), position - reference_starts[reference_id], 0, reverse});
+		});
+	}
+	return count;
+    };
+
+    auto search_query = [&](std::span<seqan3::dna5 const> q, size_t query_id, std::string& out) {
+	auto count = search_strand(q, query_id, false, out);
+	if (both) {
+		auto reverse = std::vector<seqan3::dna5>{};
+		reverse_complement(q, reverse);
+		count += search_strand(reverse, query_id, true, out);
+	}
+	if (locate.count_only) {
+		for_each_original(fan_out, query_id, [&](size_t id) {
+			append_count(out, format, id, count);
+		});
+	}
+    };
+
+    if (stream) {
+        // parse, search and print batches of queries concurrently, see query_pipeline.hpp
+        auto benchmark = Benchmark("sa_stream" + method_suffix, reference_file, query_file, 0);
+        int read_num = 0;
+        run_query_pipeline(query_file, number_of_queries, [&](QueryBatch const& batch, std::string& out) {
+            for (size_t i = 0; i < batch.queries.size(); i++) {
+                auto const start = std::chrono::steady_clock::now();
+                search_query(batch.queries[i], batch.first_id + i, out);
+                benchmark.record_query(std::chrono::steady_clock::now() - start);
+            }
+        }, [&](OutputBatch const& batch) {
+            writer.write(batch.text);
+            for (size_t i = 0; i < batch.query_count; i++) {
+                if (read_num % 10 == 0) {
+                    benchmark.write(read_num);
+                }
+                read_num++;
+            }
+        });
+        writer.flush();
+        benchmark.phase("search"); // includes the output, which overlaps with it
+        return 0;
+    }
+
     // read query into memory
+    auto query_stream = seqan3::sequence_file_input{query_file};
     std::vector<std::vector<seqan3::dna5>> queries;
     for (auto& record : query_stream) {
         queries.push_back(record.sequence());
@@ -103,20 +185,26 @@ int main(int argc, char const* const* argv) {
         std::copy_n(queries.begin(), old_count, queries.begin() + old_count);
     }
     queries.resize(number_of_queries); // will reduce the amount of searches
-    auto construct_benchmark = Benchmark("sa_construct", reference_file, "", 0);
-    auto suffixarray = fmindex_collection::createSA64(std::span{reinterpret_cast<uint8_t const*>(reference.data()), reference.size()}, 1);
-    construct_benchmark.write(0);
+
+    // with --dedup only the distinct queries are searched, see query_dedup.hpp
+    auto dedup = QueryDedup{};
+    if (use_dedup) {
+        dedup   = dedup_queries(queries);
+        fan_out = &dedup;
+    }
+    auto const searched = use_dedup ? dedup.unique : std::vector<std::span<seqan3::dna5 const>>(queries.begin(), queries.end());
+    load_benchmark.phase("load_queries");
+
     int read_num = 0;
-    auto benchmark = Benchmark("sa", reference_file, query_file, 0);
-    for (auto& q : queries) {
-        //!TODO !ImplementMe apply binary search and find q  in reference using binary search on `suffixarray`
-        // You can choose if you want to use binary search based on "naive approach", "mlr-trick", "lcp"
-	auto results = naive_binary_search(&q, &reference, &suffixarray);
-	if (std::get<0>(results) >= 0) {
-		for (auto i = 0; i < std::get<1>(results)-std::get<0>(results)+1; i++) {
-			if (!quiet)
-				seqan3::debug_stream  << q << "\n";
-		}
+    auto benchmark = Benchmark((use_dedup ? "sa_dedup" : "sa") + method_suffix, reference_file, query_file, 0);
+    auto out = std::string{};
+    for (size_t query_id = 0; query_id < searched.size(); query_id++) {
+	auto const start = std::chrono::steady_clock::now();
+	search_query(searched[query_id], query_id, out);
+	benchmark.record_query(std::chrono::steady_clock::now() - start);
+	if (out.size() >= ResultWriter::buffer_size / 4) {
+		writer.write(out);
+		out.clear();
 	}
 
 	if (read_num % 10 == 0) {
@@ -124,6 +212,13 @@ int main(int argc, char const* const* argv) {
 	}
 	read_num++;
     }
+    writer.write(out);
+    benchmark.phase("search");
+    writer.flush();
+    benchmark.phase("output");
+    if (use_dedup) {
+        benchmark.write_stat("cache_hit_rate", dedup.hit_rate());
+    }
 
     return 0;
 }
@@ -0,0 +1,51 @@
+#ifndef SUFFIXARRAY_SEARCH_HPP
+#define SUFFIXARRAY_SEARCH_HPP
+
+#include <algorithm>
+#include <ranges>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna5.hpp>
+#include <seqan3/alphabet/views/to_char.hpp>
+
+// first and last suffix array entry of the occurrences of `query`, (-1, -1) if it does not occur
+inline std::tuple<int, int> naive_binary_search(std::span<seqan3::dna5 const> const* query, std::vector<seqan3::dna5> const* reference, std::vector<long unsigned int> const* sa) {
+	unsigned long int min_index = 0;
+	unsigned long int max_index = sa->size();
+
+	while (min_index < max_index) {
+		auto c = (min_index + max_index)/2;
+		auto ref_view = *reference | std::views::drop(sa->at(c)) | std::views::take(query->size()) | seqan3::views::to_char;
+		auto query_view = *query | seqan3::views::to_char;
+		if (std::ranges::lexicographical_compare(ref_view, query_view)) {
+			min_index = c + 1;
+		} else {
+			max_index = c;
+		}
+	}
+
+	auto first = min_index;
+	max_index = sa->size();
+
+	while (min_index < max_index) {
+		auto c = (min_index + max_index)/2;
+		auto ref_view = *reference | std::views::drop(sa->at(c)) | std::views::take(query->size()) | seqan3::views::to_char;
+		auto query_view = *query | seqan3::views::to_char;
+
+		if (std::ranges::lexicographical_compare(query_view, ref_view)) {
+			max_index = c;
+		} else {
+			min_index = c + 1;
+		}
+	}
+	auto last = max_index-1;
+	if ((first > last) || !(std::equal(reference->begin()+sa->at(first), reference->begin()+sa->at(first)+query->size(), query->begin()))) {
+		return std::make_tuple(-1, -1);
+	}
+
+	return std::make_tuple(first, last);
+}
+
+#endif